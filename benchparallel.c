@@ -0,0 +1,93 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+#include "threadpool.h"
+
+#define BENCH_COUNT (1 << 22)
+#define BENCH_ROUNDS 5
+
+double bench_seconds() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+int bench_compare(const void *a, const void *b) {
+    unsigned int x = *(const unsigned int *) a;
+    unsigned int y = *(const unsigned int *) b;
+    return (x > y) - (x < y);
+}
+
+void bench_add(void *accumulator, const void *element, void *context) {
+    *(unsigned int *) accumulator += *(const unsigned int *) element;
+}
+
+void bench_fill(unsigned int *data, size_t count, unsigned int seed) {
+    for (size_t i = 0; i < count; i++) {
+        seed = seed * 1103515245u + 12345u;
+        data[i] = seed;
+    }
+}
+
+bool bench_sorted(const unsigned int *data, size_t count) {
+    for (size_t i = 1; i < count; i++) {
+        if (data[i - 1] > data[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char **argv) {
+    size_t count = argc > 1 ? strtoul(argv[1], NULL, 10) : BENCH_COUNT;
+    tp_config config = tp_utils_defaultconfig();
+    config.min_threads = tp_info_hardwareconcurrency();
+    config.stacksize = 1 << 20;
+    tp_threadpool *pool;
+    tp_error error = tp_create(&pool, config);
+    if (error) {
+        char message[TP_MESSAGE_MAXSIZE];
+        fprintf(stderr, "tp_create: %s\n", tp_utils_errormessage(error, message));
+        return 1;
+    }
+    unsigned int *data = malloc(count * sizeof(unsigned int));
+    if (!data) {
+        return 1;
+    }
+    double serial = 0, parallel = 0;
+    bool valid = true;
+    for (unsigned int round = 0; round < BENCH_ROUNDS; round++) {
+        bench_fill(data, count, round);
+        double began = bench_seconds();
+        qsort(data, count, sizeof(unsigned int), &bench_compare);
+        serial += bench_seconds() - began;
+        bench_fill(data, count, round);
+        began = bench_seconds();
+        error = tp_parallel_sort(pool, data, count, sizeof(unsigned int), &bench_compare);
+        parallel += bench_seconds() - began;
+        valid = valid && !error && bench_sorted(data, count);
+    }
+    printf("sort   %zu elements, %zu threads: qsort %.3fs  tp_parallel_sort %.3fs  speedup %.2fx  %s\n", count, config.min_threads, serial / BENCH_ROUNDS, parallel / BENCH_ROUNDS, serial / parallel, valid ? "ok" : "WRONG");
+    serial = parallel = 0;
+    valid = true;
+    bench_fill(data, count, BENCH_ROUNDS);
+    for (unsigned int round = 0; round < BENCH_ROUNDS; round++) {
+        unsigned int expected = 0, actual = 0, identity = 0;
+        double began = bench_seconds();
+        for (size_t i = 0; i < count; i++) {
+            bench_add(&expected, &data[i], NULL);
+        }
+        serial += bench_seconds() - began;
+        began = bench_seconds();
+        error = tp_parallel_reduce(pool, data, count, sizeof(unsigned int), 4096, &identity, &bench_add, &actual, NULL);
+        parallel += bench_seconds() - began;
+        valid = valid && !error && actual == expected;
+    }
+    printf("reduce %zu elements, %zu threads: serial %.3fs  tp_parallel_reduce %.3fs  speedup %.2fx  %s\n", count, config.min_threads, serial / BENCH_ROUNDS, parallel / BENCH_ROUNDS, serial / parallel, valid ? "ok" : "WRONG");
+    free(data);
+    tp_shutdown(pool);
+    tp_destroy(pool);
+    return valid ? 0 : 1;
+}
@@ -0,0 +1,102 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <unistd.h>
+#include <time.h>
+#include "threadpool.h"
+
+#define BENCH_FIRED 20000
+#define BENCH_SPREAD_NS 2000000000ULL
+#define BENCH_PENDING 1000000
+
+typedef struct {
+    unsigned long long due;
+    unsigned long long fired;
+} bench_shot;
+
+atomic_size_t bench_hits;
+
+unsigned long long bench_nanos() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+int bench_fire(void *taskdata, void *userdata) {
+    ((bench_shot *) taskdata)->fired = bench_nanos();
+    atomic_fetch_add(&bench_hits, 1);
+    return 0;
+}
+
+int bench_nothing(void *taskdata, void *userdata) {
+    return 0;
+}
+
+int bench_compare(const void *a, const void *b) {
+    long long x = *(const long long *) a;
+    long long y = *(const long long *) b;
+    return (x > y) - (x < y);
+}
+
+int main(int argc, char **argv) {
+    tp_config config = tp_utils_defaultconfig();
+    config.min_threads = 2;
+    config.stacksize = 1 << 20;
+    if (argc > 1) {
+        config.timer_tick_micros = strtoul(argv[1], NULL, 10);
+    }
+    tp_threadpool *pool;
+    tp_error error = tp_create(&pool, config);
+    if (error) {
+        char message[TP_MESSAGE_MAXSIZE];
+        fprintf(stderr, "tp_create: %s\n", tp_utils_errormessage(error, message));
+        return 1;
+    }
+    bench_shot *shots = malloc(BENCH_FIRED * sizeof(bench_shot));
+    long long *lateness = malloc(BENCH_FIRED * sizeof(long long));
+    tp_timer **timers = malloc(BENCH_PENDING * sizeof(tp_timer *));
+    if (!shots || !lateness || !timers) {
+        return 1;
+    }
+    srand(1);
+    for (size_t i = 0; i < BENCH_FIRED; i++) {
+        unsigned long long delay = (unsigned long long) rand() % BENCH_SPREAD_NS;
+        shots[i].due = bench_nanos() + delay;
+        shots[i].fired = 0;
+        tp_enqueue_after(pool, &bench_fire, &shots[i], delay, NULL);
+    }
+    while (atomic_load(&bench_hits) < BENCH_FIRED) {
+        usleep(10000);
+    }
+    size_t early = 0;
+    for (size_t i = 0; i < BENCH_FIRED; i++) {
+        lateness[i] = (long long) (shots[i].fired - shots[i].due);
+        early += lateness[i] < 0;
+    }
+    qsort(lateness, BENCH_FIRED, sizeof(long long), &bench_compare);
+    printf("precision %d timers, tick %zuus: p50 %.3fms  p99 %.3fms  max %.3fms  early %zu\n", BENCH_FIRED, config.timer_tick_micros, lateness[BENCH_FIRED / 2] / 1e6, lateness[BENCH_FIRED / 100 * 99] / 1e6, lateness[BENCH_FIRED - 1] / 1e6, early);
+    unsigned long long began = bench_nanos();
+    for (size_t i = 0; i < BENCH_PENDING; i++) {
+        tp_enqueue_after(pool, &bench_nothing, NULL, 60000000000ULL + i * 1000ULL, &timers[i]);
+    }
+    unsigned long long inserted = bench_nanos();
+    size_t pending = tp_timers_pending(pool);
+    size_t cancelled = 0;
+    for (size_t i = 0; i < BENCH_PENDING; i++) {
+        bool wascancelled;
+        tp_timer_cancel(timers[i], &wascancelled);
+        cancelled += wascancelled;
+    }
+    unsigned long long finished = bench_nanos();
+    for (size_t i = 0; i < BENCH_PENDING; i++) {
+        tp_timer_release(timers[i]);
+    }
+    printf("pending %d timers: insert %.0fns/op  cancel %.0fns/op  pending %zu  cancelled %zu  left %zu\n", BENCH_PENDING, (double) (inserted - began) / BENCH_PENDING, (double) (finished - inserted) / BENCH_PENDING, pending, cancelled, tp_timers_pending(pool));
+    free(timers);
+    free(lateness);
+    free(shots);
+    tp_shutdown(pool);
+    tp_destroy(pool);
+    return early || pending != BENCH_PENDING || cancelled != BENCH_PENDING ? 1 : 0;
+}
@@ -1,7 +1,12 @@
+#include <stdlib.h>
 #include <stdbool.h>
+#include <stdatomic.h>
 #include <pthread.h>
+#include <time.h>
+#include <string.h>
 #include "tpdefs.h"
 #include "utilities.h"
+#include "histogram.h"
 #include "counting.h"
 
 tpi_error tpc_counter_init(tpc_counter *counter, pthread_mutex_t *mutex) {
@@ -18,23 +23,21 @@ tpi_error tpc_counter_init(tpc_counter *counter, pthread_mutex_t *mutex) {
         pthread_cond_destroy(&counter->dec_cond);
         return tpu_pthread_to_tpi(holder);
     }
-    counter->count = 0;
+    atomic_init(&counter->count, 0);
     counter->mutex = mutex;
     return TPI_ERROR_OK;
 }
 
-void tpc_counter_increment(tpc_counter *counter) {
-    counter->count++;
-    pthread_cond_broadcast(&counter->inc_cond);
+size_t tpc_counter_lower(tpc_counter *counter, size_t amount) {
+    size_t previous = atomic_load(&counter->count);
+    while (previous && !atomic_compare_exchange_weak(&counter->count, &previous, previous > amount ? previous - amount : 0));
+    return previous;
 }
 
-void tpc_counter_decrement(tpc_counter *counter) {
-    if (counter->count) {
-        counter->count--;
-        pthread_cond_broadcast(&counter->dec_cond);
-        if (counter->count == 0) {
-            pthread_cond_broadcast(&counter->zero_cond);
-        }
+void tpc_counter_broadcast(tpc_counter *counter, size_t previous, size_t amount) {
+    pthread_cond_broadcast(&counter->dec_cond);
+    if (previous <= amount) {
+        pthread_cond_broadcast(&counter->zero_cond);
     }
 }
 
@@ -47,9 +50,7 @@ void tpc_counter_waitfor(tpc_counter *counter, tpc_event event) {
             pthread_cond_wait(&counter->dec_cond, counter->mutex);
             break;
         case TPC_EVENT_ZERO:
-            if (counter->count) {
-                pthread_cond_wait(&counter->zero_cond, counter->mutex);
-            }
+            pthread_cond_wait(&counter->zero_cond, counter->mutex);
             break;
     }
 }
@@ -61,10 +62,7 @@ bool tpc_counter_timedwaitfor(tpc_counter *counter, tpc_event event, size_t mill
         case TPC_EVENT_DECREMENT:
             return tpu_relative_wait(&counter->dec_cond, counter->mutex, millis);
         case TPC_EVENT_ZERO:
-            if (counter->count) {
-                return tpu_relative_wait(&counter->zero_cond, counter->mutex, millis);
-            }
-            return true;
+            return tpu_relative_wait(&counter->zero_cond, counter->mutex, millis);
     }
 }
 
@@ -74,35 +72,133 @@ void tpc_counter_destroy(tpc_counter *counter) {
     pthread_cond_destroy(&counter->zero_cond);
 }
 
-tpi_error tpc_manifest_init(tpc_manifest *manifest, void (* onstatschanged)(tpi_stats, void *), void *userdata) {
+void tpc_manifest_deliver(tpc_manifest *manifest) {
+    tpi_stats after = tpc_manifest_stats(manifest);
+    if (!tpu_stats_equal(manifest->previous, after)) {
+        manifest->onstatschanged(after, manifest->userdata);
+        manifest->previous = after;
+    }
+}
+
+void * tpc_notifier_routine(void *arg) {
+    tpc_manifest *manifest = arg;
+    tpc_notifier *notifier = manifest->notifier;
+    size_t delivered = tpu_microtime() - manifest->interval;
+    pthread_mutex_lock(&notifier->mutex);
+    while (!notifier->stopping) {
+        if (!atomic_load(&notifier->dirty)) {
+            pthread_cond_wait(&notifier->cond, &notifier->mutex);
+            continue;
+        }
+        size_t elapsed = tpu_microtime() - delivered;
+        if (elapsed < manifest->interval) {
+            struct timespec until = tpu_micro_timespec(manifest->interval - elapsed);
+            pthread_cond_timedwait(&notifier->cond, &notifier->mutex, &until);
+            continue;
+        }
+        atomic_store(&notifier->dirty, false);
+        atomic_thread_fence(memory_order_seq_cst);
+        pthread_mutex_unlock(&notifier->mutex);
+        tpc_manifest_deliver(manifest);
+        delivered = tpu_microtime();
+        pthread_mutex_lock(&notifier->mutex);
+    }
+    pthread_mutex_unlock(&notifier->mutex);
+    tpc_manifest_deliver(manifest);
+    return NULL;
+}
+
+tpi_error tpc_notifier_start(tpc_manifest *manifest) {
+    tpc_notifier *notifier = malloc(sizeof(tpc_notifier));
+    if (!notifier) {
+        return TPI_ERROR_NOMEMORY;
+    }
+    int holder = 0;
+    if ((holder = pthread_mutex_init(&notifier->mutex, NULL))) {
+        free(notifier);
+        return tpu_pthread_to_tpi(holder);
+    }
+    if ((holder = pthread_cond_init(&notifier->cond, NULL))) {
+        pthread_mutex_destroy(&notifier->mutex);
+        free(notifier);
+        return tpu_pthread_to_tpi(holder);
+    }
+    atomic_init(&notifier->dirty, false);
+    notifier->stopping = false;
+    manifest->notifier = notifier;
+    if ((holder = pthread_create(&notifier->thread, NULL, &tpc_notifier_routine, manifest))) {
+        manifest->notifier = NULL;
+        pthread_cond_destroy(&notifier->cond);
+        pthread_mutex_destroy(&notifier->mutex);
+        free(notifier);
+        return tpu_pthread_to_tpi(holder);
+    }
+    return TPI_ERROR_OK;
+}
+
+void tpc_manifest_touch(tpc_manifest *manifest) {
+    tpc_notifier *notifier = manifest->notifier;
+    if (!notifier) {
+        return;
+    }
+    atomic_thread_fence(memory_order_seq_cst);
+    if (!atomic_load_explicit(&notifier->dirty, memory_order_relaxed) && !atomic_exchange(&notifier->dirty, true)) {
+        pthread_mutex_lock(&notifier->mutex);
+        pthread_cond_signal(&notifier->cond);
+        pthread_mutex_unlock(&notifier->mutex);
+    }
+}
+
+tpi_error tpc_manifest_init(tpc_manifest *manifest, size_t shards, size_t interval, void (* onstatschanged)(tpi_stats, void *), void *userdata) {
+    if ((manifest->shards = tpu_aligned_calloc(shards, sizeof(tpc_shard))) == NULL && shards) {
+        return TPI_ERROR_NOMEMORY;
+    }
+    manifest->num_shards = shards;
+    for (size_t i = 0; i < shards; i++) {
+        tph_init(&manifest->shards[i].waited);
+        tph_init(&manifest->shards[i].ran);
+    }
     int holder = 0;
     if ((holder = pthread_mutex_init(&manifest->mutex, NULL))) {
+        free(manifest->shards);
         return tpu_pthread_to_tpi(holder);
     }
     tpi_error errhld = TPI_ERROR_OK;
     if ((errhld = tpc_counter_init(&manifest->num_workers, &manifest->mutex))) {
         pthread_mutex_destroy(&manifest->mutex);
+        free(manifest->shards);
         return errhld;
     }
     if ((errhld = tpc_counter_init(&manifest->num_queued, &manifest->mutex))) {
         tpc_counter_destroy(&manifest->num_workers);
         pthread_mutex_destroy(&manifest->mutex);
+        free(manifest->shards);
         return errhld;
     }
     if ((errhld = tpc_counter_init(&manifest->num_busy, &manifest->mutex))) {
         tpc_counter_destroy(&manifest->num_queued);
         tpc_counter_destroy(&manifest->num_workers);
         pthread_mutex_destroy(&manifest->mutex);
+        free(manifest->shards);
         return errhld;
     }
-    manifest->num_complete = 0;
-    manifest->num_success = 0;
-    manifest->cpu_seconds = 0;
+    atomic_init(&manifest->waiting, 0);
+    atomic_init(&manifest->cancelled, 0);
     manifest->onstatschanged = onstatschanged;
     manifest->userdata = userdata;
+    manifest->interval = onstatschanged ? interval : 0;
+    manifest->notifier = NULL;
     if (manifest->onstatschanged) {
         manifest->previous = tpc_manifest_stats(manifest);
     }
+    if (manifest->interval && (errhld = tpc_notifier_start(manifest))) {
+        tpc_counter_destroy(&manifest->num_busy);
+        tpc_counter_destroy(&manifest->num_queued);
+        tpc_counter_destroy(&manifest->num_workers);
+        pthread_mutex_destroy(&manifest->mutex);
+        free(manifest->shards);
+        return errhld;
+    }
     return TPI_ERROR_OK;
 }
 
@@ -111,92 +207,274 @@ void tpc_manifest_acquire(tpc_manifest *manifest) {
 }
 
 void tpc_manifest_release(tpc_manifest *manifest) {
-    if (manifest->onstatschanged) {
-        tpi_stats after = tpc_manifest_stats(manifest);
-        if (!tpu_stats_equal(manifest->previous, after)) {
-            manifest->onstatschanged(after, manifest->userdata);
-            manifest->previous = after;
-        }
+    if (manifest->onstatschanged && !manifest->interval) {
+        tpc_manifest_deliver(manifest);
     }
     pthread_mutex_unlock(&manifest->mutex);
+    tpc_manifest_touch(manifest);
 }
 
 tpi_stats tpc_manifest_stats(tpc_manifest *manifest) {
     tpi_stats stats = {
-        .num_workers = manifest->num_workers.count,
-        .num_queued = manifest->num_queued.count,
-        .num_busy = manifest->num_busy.count,
-        .num_complete = manifest->num_complete,
-        .num_success = manifest->num_success,
-        .cpu_time = manifest->cpu_seconds
+        .num_workers = atomic_load(&manifest->num_workers.count),
+        .num_queued = atomic_load(&manifest->num_queued.count),
+        .num_busy = 0,
+        .num_complete = 0,
+        .num_success = 0,
+        .num_expired = 0,
+        .num_cancelled = atomic_load(&manifest->cancelled),
+        .cpu_time = 0,
+        .wall_time = 0
     };
-    return stats;
-}
-
-void tpc_manifest_tallyresult(tpc_manifest *manifest, int result, clock_t ticks) {
-    manifest->num_complete++;
-    manifest->cpu_seconds += ((double) ticks) / CLOCKS_PER_SEC;
-    if (result == 0) {
-        manifest->num_success++;
+    unsigned long long nanos = 0, walled = 0;
+    for (size_t i = 0; i < manifest->num_shards; i++) {
+        tpc_shard *shard = &manifest->shards[i];
+        unsigned int before, after;
+        size_t complete, success, expired;
+        unsigned long long cpu, wall;
+        do {
+            before = atomic_load_explicit(&shard->sequence, memory_order_acquire);
+            complete = atomic_load_explicit(&shard->complete, memory_order_relaxed);
+            success = atomic_load_explicit(&shard->success, memory_order_relaxed);
+            expired = atomic_load_explicit(&shard->expired, memory_order_relaxed);
+            cpu = atomic_load_explicit(&shard->cpu_nanos, memory_order_relaxed);
+            wall = atomic_load_explicit(&shard->wall_nanos, memory_order_relaxed);
+            atomic_thread_fence(memory_order_acquire);
+            after = atomic_load_explicit(&shard->sequence, memory_order_relaxed);
+        } while (before != after || (before & 1));
+        stats.num_busy += atomic_load(&shard->busy);
+        stats.num_complete += complete;
+        stats.num_success += success;
+        stats.num_expired += expired;
+        nanos += cpu;
+        walled += wall;
     }
+    stats.cpu_time = nanos / 1e9;
+    stats.wall_time = walled / 1e9;
+    return stats;
 }
 
-void tpc_manifest_increment(tpc_manifest *manifest, tpc_target target) {
+tpc_counter * tpc_manifest_counter(tpc_manifest *manifest, tpc_target target) {
     switch (target) {
         case TPC_TARGET_WORKERS:
-            tpc_counter_increment(&manifest->num_workers);
-            break;
+            return &manifest->num_workers;
         case TPC_TARGET_QUEUED:
-            tpc_counter_increment(&manifest->num_queued);
-            break;
+            return &manifest->num_queued;
         case TPC_TARGET_BUSY:
-            tpc_counter_increment(&manifest->num_busy);
-            break;
+            return &manifest->num_busy;
     }
 }
 
-void tpc_manifest_decrement(tpc_manifest *manifest, tpc_target target) {
-    switch (target) {
-        case TPC_TARGET_WORKERS:
-            tpc_counter_decrement(&manifest->num_workers);
-            break;
-        case TPC_TARGET_QUEUED:
-            tpc_counter_decrement(&manifest->num_queued);
-            break;
-        case TPC_TARGET_BUSY:
-            tpc_counter_decrement(&manifest->num_busy);
-            break;
+bool tpc_manifest_isobserved(tpc_manifest *manifest) {
+    return (manifest->onstatschanged && !manifest->interval) || atomic_load(&manifest->waiting);
+}
+
+void tpc_manifest_add(tpc_manifest *manifest, tpc_target target, size_t amount) {
+    tpc_counter *counter = tpc_manifest_counter(manifest, target);
+    atomic_fetch_add(&counter->count, amount);
+    pthread_cond_broadcast(&counter->inc_cond);
+}
+
+void tpc_manifest_quickadd(tpc_manifest *manifest, tpc_target target, size_t amount) {
+    tpc_counter *counter = tpc_manifest_counter(manifest, target);
+    atomic_fetch_add(&counter->count, amount);
+    if (tpc_manifest_isobserved(manifest)) {
+        tpc_manifest_acquire(manifest);
+        pthread_cond_broadcast(&counter->inc_cond);
+        tpc_manifest_release(manifest);
+    } else {
+        tpc_manifest_touch(manifest);
+    }
+}
+
+void tpc_manifest_quicksubtract(tpc_manifest *manifest, tpc_target target, size_t amount) {
+    tpc_counter *counter = tpc_manifest_counter(manifest, target);
+    size_t previous = tpc_counter_lower(counter, amount);
+    if (previous && tpc_manifest_isobserved(manifest)) {
+        tpc_manifest_acquire(manifest);
+        tpc_counter_broadcast(counter, previous, amount);
+        tpc_manifest_release(manifest);
+    } else if (previous) {
+        tpc_manifest_touch(manifest);
     }
 }
 
+void tpc_manifest_quickincrement(tpc_manifest *manifest, tpc_target target) {
+    tpc_manifest_quickadd(manifest, target, 1);
+}
+
+void tpc_manifest_quickdecrement(tpc_manifest *manifest, tpc_target target) {
+    tpc_manifest_quicksubtract(manifest, target, 1);
+}
+
+size_t tpc_manifest_count(tpc_manifest *manifest, tpc_target target) {
+    if (target != TPC_TARGET_BUSY) {
+        return atomic_load(&tpc_manifest_counter(manifest, target)->count);
+    }
+    size_t busy = 0;
+    for (size_t i = 0; i < manifest->num_shards; i++) {
+        busy += atomic_load(&manifest->shards[i].busy);
+    }
+    return busy;
+}
+
+tpc_shard * tpc_manifest_shard(tpc_manifest *manifest, size_t index) {
+    return &manifest->shards[index];
+}
+
+void tpc_manifest_begin(tpc_manifest *manifest, tpc_shard *shard) {
+    atomic_store(&shard->busy, 1);
+    if (tpc_manifest_isobserved(manifest)) {
+        tpc_manifest_acquire(manifest);
+        pthread_cond_broadcast(&manifest->num_busy.inc_cond);
+        tpc_manifest_release(manifest);
+    } else {
+        tpc_manifest_touch(manifest);
+    }
+}
+
+void tpc_manifest_idle(tpc_manifest *manifest, tpc_shard *shard) {
+    atomic_store(&shard->busy, 0);
+    if (tpc_manifest_isobserved(manifest)) {
+        tpc_manifest_acquire(manifest);
+        pthread_cond_broadcast(&manifest->num_busy.dec_cond);
+        if (tpc_manifest_count(manifest, TPC_TARGET_BUSY) == 0) {
+            pthread_cond_broadcast(&manifest->num_busy.zero_cond);
+        }
+        tpc_manifest_release(manifest);
+    } else {
+        tpc_manifest_touch(manifest);
+    }
+}
+
+void tpc_manifest_finish(tpc_manifest *manifest, tpc_shard *shard, int result, unsigned long long cpu, unsigned long long wall) {
+    unsigned int sequence = atomic_load_explicit(&shard->sequence, memory_order_relaxed);
+    atomic_store_explicit(&shard->sequence, sequence + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    atomic_store_explicit(&shard->complete, atomic_load_explicit(&shard->complete, memory_order_relaxed) + 1, memory_order_relaxed);
+    if (result == 0) {
+        atomic_store_explicit(&shard->success, atomic_load_explicit(&shard->success, memory_order_relaxed) + 1, memory_order_relaxed);
+    }
+    atomic_store_explicit(&shard->cpu_nanos, atomic_load_explicit(&shard->cpu_nanos, memory_order_relaxed) + cpu, memory_order_relaxed);
+    atomic_store_explicit(&shard->wall_nanos, atomic_load_explicit(&shard->wall_nanos, memory_order_relaxed) + wall, memory_order_relaxed);
+    atomic_store_explicit(&shard->sequence, sequence + 2, memory_order_release);
+    tpc_manifest_idle(manifest, shard);
+}
+
+void tpc_manifest_expire(tpc_manifest *manifest, tpc_shard *shard) {
+    unsigned int sequence = atomic_load_explicit(&shard->sequence, memory_order_relaxed);
+    atomic_store_explicit(&shard->sequence, sequence + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    atomic_store_explicit(&shard->expired, atomic_load_explicit(&shard->expired, memory_order_relaxed) + 1, memory_order_relaxed);
+    atomic_store_explicit(&shard->sequence, sequence + 2, memory_order_release);
+    tpc_manifest_idle(manifest, shard);
+}
+
+void tpc_manifest_cancel(tpc_manifest *manifest, tpc_shard *shard) {
+    atomic_fetch_add(&manifest->cancelled, 1);
+    tpc_manifest_idle(manifest, shard);
+}
+
+void tpc_manifest_purge(tpc_manifest *manifest, size_t count) {
+    atomic_fetch_add(&manifest->cancelled, count);
+    tpc_manifest_quicksubtract(manifest, TPC_TARGET_QUEUED, count);
+}
+
+void tpc_manifest_record(tpc_manifest *manifest, tpc_shard *shard, unsigned long long waited, unsigned long long ran) {
+    tph_record(&shard->waited, waited);
+    tph_record(&shard->ran, ran);
+    atomic_store_explicit(&shard->timed, atomic_load_explicit(&shard->timed, memory_order_relaxed) + 1, memory_order_relaxed);
+    atomic_store_explicit(&shard->wait_nanos, atomic_load_explicit(&shard->wait_nanos, memory_order_relaxed) + waited, memory_order_relaxed);
+}
+
+void tpc_manifest_waited(tpc_manifest *manifest, size_t *timed, unsigned long long *nanos) {
+    *timed = 0;
+    *nanos = 0;
+    for (size_t i = 0; i < manifest->num_shards; i++) {
+        *timed += atomic_load_explicit(&manifest->shards[i].timed, memory_order_relaxed);
+        *nanos += atomic_load_explicit(&manifest->shards[i].wait_nanos, memory_order_relaxed);
+    }
+}
+
+void tpc_manifest_latency(tpc_manifest *manifest, bool reset, tpi_latency *waited, tpi_latency *ran) {
+    unsigned long long counts[TPH_BUCKETS];
+    unsigned long long max = 0;
+    pthread_mutex_lock(&manifest->mutex);
+    bzero(counts, sizeof(counts));
+    for (size_t i = 0; i < manifest->num_shards; i++) {
+        tph_collect(&manifest->shards[i].waited, counts, &max, reset);
+    }
+    *waited = tph_summarize(counts, max);
+    max = 0;
+    bzero(counts, sizeof(counts));
+    for (size_t i = 0; i < manifest->num_shards; i++) {
+        tph_collect(&manifest->shards[i].ran, counts, &max, reset);
+    }
+    *ran = tph_summarize(counts, max);
+    pthread_mutex_unlock(&manifest->mutex);
+}
+
+bool tpc_manifest_retire(tpc_manifest *manifest, size_t minimum) {
+    tpc_counter *counter = &manifest->num_workers;
+    size_t workers = atomic_load(&counter->count);
+    while (minimum < workers) {
+        if (atomic_compare_exchange_weak(&counter->count, &workers, workers - 1)) {
+            if (tpc_manifest_isobserved(manifest)) {
+                tpc_manifest_acquire(manifest);
+                tpc_counter_broadcast(counter, workers, 1);
+                tpc_manifest_release(manifest);
+            } else {
+                tpc_manifest_touch(manifest);
+            }
+            return true;
+        }
+    }
+    return false;
+}
+
 void tpc_manifest_waitfor(tpc_manifest *manifest, tpc_target target, tpc_event event) {
-    switch (target) {
-        case TPC_TARGET_WORKERS:
-            tpc_counter_waitfor(&manifest->num_workers, event);
-            break;
-        case TPC_TARGET_QUEUED:
-            tpc_counter_waitfor(&manifest->num_queued, event);
-            break;
-        case TPC_TARGET_BUSY:
-            tpc_counter_waitfor(&manifest->num_busy, event);
-            break;
+    atomic_fetch_add(&manifest->waiting, 1);
+    if (event != TPC_EVENT_ZERO || tpc_manifest_count(manifest, target)) {
+        tpc_counter_waitfor(tpc_manifest_counter(manifest, target), event);
     }
+    atomic_fetch_sub(&manifest->waiting, 1);
 }
 
 bool tpc_manifest_timedwaitfor(tpc_manifest *manifest, tpc_target target, tpc_event event, size_t millis) {
-    switch (target) {
-        case TPC_TARGET_WORKERS:
-            return tpc_counter_timedwaitfor(&manifest->num_workers, event, millis);
-        case TPC_TARGET_QUEUED:
-            return tpc_counter_timedwaitfor(&manifest->num_queued, event, millis);
-        case TPC_TARGET_BUSY:
-            return tpc_counter_timedwaitfor(&manifest->num_busy, event, millis);
+    bool result = true;
+    atomic_fetch_add(&manifest->waiting, 1);
+    if (event != TPC_EVENT_ZERO || tpc_manifest_count(manifest, target)) {
+        result = tpc_counter_timedwaitfor(tpc_manifest_counter(manifest, target), event, millis);
+    }
+    atomic_fetch_sub(&manifest->waiting, 1);
+    return result;
+}
+
+void tpc_manifest_flush(tpc_manifest *manifest) {
+    tpc_notifier *notifier = manifest->notifier;
+    if (!notifier) {
+        return;
+    }
+    pthread_mutex_lock(&notifier->mutex);
+    bool stopping = notifier->stopping;
+    notifier->stopping = true;
+    pthread_cond_signal(&notifier->cond);
+    pthread_mutex_unlock(&notifier->mutex);
+    if (!stopping) {
+        pthread_join(notifier->thread, NULL);
     }
 }
 
 void tpc_manifest_destroy(tpc_manifest *manifest) {
+    tpc_manifest_flush(manifest);
+    if (manifest->notifier) {
+        pthread_cond_destroy(&manifest->notifier->cond);
+        pthread_mutex_destroy(&manifest->notifier->mutex);
+        free(manifest->notifier);
+    }
     tpc_counter_destroy(&manifest->num_workers);
     tpc_counter_destroy(&manifest->num_queued);
     tpc_counter_destroy(&manifest->num_busy);
     pthread_mutex_destroy(&manifest->mutex);
+    free(manifest->shards);
 }
\ No newline at end of file
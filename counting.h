@@ -6,20 +6,45 @@ typedef struct {
     pthread_cond_t inc_cond;
     pthread_cond_t dec_cond;
     pthread_cond_t zero_cond;
-    size_t count;
+    atomic_size_t count;
 } tpc_counter;
 
+typedef struct {
+    _Alignas(TPU_CACHELINE) atomic_uint sequence;
+    atomic_size_t busy;
+    atomic_size_t complete;
+    atomic_size_t success;
+    atomic_size_t expired;
+    atomic_ullong cpu_nanos;
+    atomic_ullong wall_nanos;
+    atomic_size_t timed;
+    atomic_ullong wait_nanos;
+    tph_histogram waited;
+    tph_histogram ran;
+} tpc_shard;
+
+typedef struct {
+    pthread_t thread;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    atomic_bool dirty;
+    bool stopping;
+} tpc_notifier;
+
 typedef struct {
     pthread_mutex_t mutex;
     tpc_counter num_workers;
     tpc_counter num_busy;
     tpc_counter num_queued;
-    size_t num_complete;
-    size_t num_success;
-    double cpu_seconds;
+    tpc_shard *shards;
+    size_t num_shards;
+    atomic_size_t waiting;
+    atomic_size_t cancelled;
     void (* onstatschanged)(tpi_stats, void *);
     void *userdata;
     tpi_stats previous;
+    size_t interval;
+    tpc_notifier *notifier;
 } tpc_manifest;
 
 typedef enum {
@@ -34,15 +59,29 @@ typedef enum {
     TPC_TARGET_QUEUED
 } tpc_target;
 
-tpi_error tpc_manifest_init(tpc_manifest *manifest, void (* onstatschanged)(tpi_stats, void *), void *userdata);
+tpi_error tpc_manifest_init(tpc_manifest *manifest, size_t shards, size_t interval, void (* onstatschanged)(tpi_stats, void *), void *userdata);
 void tpc_manifest_acquire(tpc_manifest *manifest);
 void tpc_manifest_release(tpc_manifest *manifest);
 tpi_stats tpc_manifest_stats(tpc_manifest *manifest);
-void tpc_manifest_tallyresult(tpc_manifest *manifest, int result, clock_t ticks);
-void tpc_manifest_increment(tpc_manifest *manifest, tpc_target target);
-void tpc_manifest_decrement(tpc_manifest *manifest, tpc_target target);
+tpc_shard * tpc_manifest_shard(tpc_manifest *manifest, size_t index);
+void tpc_manifest_begin(tpc_manifest *manifest, tpc_shard *shard);
+void tpc_manifest_finish(tpc_manifest *manifest, tpc_shard *shard, int result, unsigned long long cpu, unsigned long long wall);
+void tpc_manifest_record(tpc_manifest *manifest, tpc_shard *shard, unsigned long long waited, unsigned long long ran);
+void tpc_manifest_waited(tpc_manifest *manifest, size_t *timed, unsigned long long *nanos);
+void tpc_manifest_latency(tpc_manifest *manifest, bool reset, tpi_latency *waited, tpi_latency *ran);
+void tpc_manifest_expire(tpc_manifest *manifest, tpc_shard *shard);
+void tpc_manifest_cancel(tpc_manifest *manifest, tpc_shard *shard);
+void tpc_manifest_purge(tpc_manifest *manifest, size_t count);
+bool tpc_manifest_retire(tpc_manifest *manifest, size_t minimum);
+void tpc_manifest_add(tpc_manifest *manifest, tpc_target target, size_t amount);
+void tpc_manifest_quickadd(tpc_manifest *manifest, tpc_target target, size_t amount);
+void tpc_manifest_quicksubtract(tpc_manifest *manifest, tpc_target target, size_t amount);
+void tpc_manifest_quickincrement(tpc_manifest *manifest, tpc_target target);
+void tpc_manifest_quickdecrement(tpc_manifest *manifest, tpc_target target);
+size_t tpc_manifest_count(tpc_manifest *manifest, tpc_target target);
 void tpc_manifest_waitfor(tpc_manifest *manifest, tpc_target target, tpc_event event);
 bool tpc_manifest_timedwaitfor(tpc_manifest *manifest, tpc_target target, tpc_event event, size_t millis);
+void tpc_manifest_flush(tpc_manifest *manifest);
 void tpc_manifest_destroy(tpc_manifest *manifest);
 
 #endif
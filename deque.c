@@ -0,0 +1,128 @@
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <string.h>
+#include <pthread.h>
+#include "tpdefs.h"
+#include "utilities.h"
+#include "deque.h"
+
+_Static_assert(sizeof(tpi_task) % sizeof(uintptr_t) == 0, "tpi_task must be a whole number of words");
+
+void tpd_cell_store(tpd_cell *cell, tpi_task task) {
+    uintptr_t words[TPD_TASK_WORDS];
+    memcpy(words, &task, sizeof(tpi_task));
+    for (size_t i = 0; i < TPD_TASK_WORDS; i++) {
+        atomic_store_explicit(&cell->words[i], words[i], memory_order_relaxed);
+    }
+}
+
+tpi_task tpd_cell_load(tpd_cell *cell) {
+    uintptr_t words[TPD_TASK_WORDS];
+    for (size_t i = 0; i < TPD_TASK_WORDS; i++) {
+        words[i] = atomic_load_explicit(&cell->words[i], memory_order_relaxed);
+    }
+    tpi_task task;
+    memcpy(&task, words, sizeof(tpi_task));
+    return task;
+}
+
+tpd_buffer * tpd_buffer_create(size_t length) {
+    tpd_buffer *buffer = malloc(sizeof(tpd_buffer) + length * sizeof(tpd_cell));
+    if (buffer) {
+        buffer->retired = NULL;
+        buffer->mask = length - 1;
+    }
+    return buffer;
+}
+
+tpi_error tpd_init(tpd_deque *deque, size_t length) {
+    tpd_buffer *buffer = tpd_buffer_create(tpu_next_pow2(length ? length : TPD_INITIAL_LENGTH));
+    if (!buffer) {
+        return TPI_ERROR_NOMEMORY;
+    }
+    atomic_init(&deque->top, 0);
+    atomic_init(&deque->bottom, 0);
+    atomic_init(&deque->buffer, buffer);
+    return TPI_ERROR_OK;
+}
+
+tpd_buffer * tpd_grow(tpd_deque *deque, tpd_buffer *buffer, long top, long bottom) {
+    tpd_buffer *grown = tpd_buffer_create((buffer->mask + 1) * 2);
+    if (!grown) {
+        return NULL;
+    }
+    for (long i = top; i < bottom; i++) {
+        tpd_cell_store(&grown->cells[i & grown->mask], tpd_cell_load(&buffer->cells[i & buffer->mask]));
+    }
+    grown->retired = buffer;
+    atomic_store_explicit(&deque->buffer, grown, memory_order_release);
+    return grown;
+}
+
+tpi_error tpd_push(tpd_deque *deque, tpi_task task) {
+    long bottom = atomic_load_explicit(&deque->bottom, memory_order_relaxed);
+    long top = atomic_load_explicit(&deque->top, memory_order_acquire);
+    tpd_buffer *buffer = atomic_load_explicit(&deque->buffer, memory_order_relaxed);
+    if ((size_t) (bottom - top) > buffer->mask) {
+        if ((buffer = tpd_grow(deque, buffer, top, bottom)) == NULL) {
+            return TPI_ERROR_NOMEMORY;
+        }
+    }
+    tpd_cell_store(&buffer->cells[bottom & buffer->mask], task);
+    atomic_thread_fence(memory_order_release);
+    atomic_store_explicit(&deque->bottom, bottom + 1, memory_order_relaxed);
+    return TPI_ERROR_OK;
+}
+
+bool tpd_pop(tpd_deque *deque, tpi_task *task) {
+    long bottom = atomic_load_explicit(&deque->bottom, memory_order_relaxed) - 1;
+    tpd_buffer *buffer = atomic_load_explicit(&deque->buffer, memory_order_relaxed);
+    atomic_store_explicit(&deque->bottom, bottom, memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+    long top = atomic_load_explicit(&deque->top, memory_order_relaxed);
+    if (bottom < top) {
+        atomic_store_explicit(&deque->bottom, bottom + 1, memory_order_relaxed);
+        return false;
+    }
+    * task = tpd_cell_load(&buffer->cells[bottom & buffer->mask]);
+    if (top == bottom) {
+        bool won = atomic_compare_exchange_strong_explicit(&deque->top, &top, top + 1, memory_order_seq_cst, memory_order_relaxed);
+        atomic_store_explicit(&deque->bottom, bottom + 1, memory_order_relaxed);
+        return won;
+    }
+    return true;
+}
+
+bool tpd_steal(tpd_deque *deque, tpi_task *task) {
+    long top = atomic_load_explicit(&deque->top, memory_order_acquire);
+    atomic_thread_fence(memory_order_seq_cst);
+    long bottom = atomic_load_explicit(&deque->bottom, memory_order_acquire);
+    if (bottom <= top) {
+        return false;
+    }
+    tpd_buffer *buffer = atomic_load_explicit(&deque->buffer, memory_order_acquire);
+    tpi_task taken = tpd_cell_load(&buffer->cells[top & buffer->mask]);
+    if (!atomic_compare_exchange_strong_explicit(&deque->top, &top, top + 1, memory_order_seq_cst, memory_order_relaxed)) {
+        return false;
+    }
+    * task = taken;
+    return true;
+}
+
+bool tpd_isempty(tpd_deque *deque) {
+    long top = atomic_load_explicit(&deque->top, memory_order_acquire);
+    long bottom = atomic_load_explicit(&deque->bottom, memory_order_acquire);
+    return bottom <= top;
+}
+
+void tpd_destroy(tpd_deque *deque) {
+    tpd_buffer *buffer = atomic_load_explicit(&deque->buffer, memory_order_relaxed);
+    while (buffer) {
+        tpd_buffer *retired = buffer->retired;
+        free(buffer);
+        buffer = retired;
+    }
+    atomic_store_explicit(&deque->buffer, NULL, memory_order_relaxed);
+}
@@ -0,0 +1,30 @@
+#ifndef deque_h
+#define deque_h
+
+#define TPD_TASK_WORDS (sizeof(tpi_task) / sizeof(uintptr_t))
+#define TPD_INITIAL_LENGTH 64
+
+typedef struct {
+    _Atomic uintptr_t words[TPD_TASK_WORDS];
+} tpd_cell;
+
+typedef struct tpd_buffer {
+    struct tpd_buffer *retired;
+    size_t mask;
+    tpd_cell cells[];
+} tpd_buffer;
+
+typedef struct {
+    _Alignas(TPU_CACHELINE) atomic_long top;
+    _Alignas(TPU_CACHELINE) atomic_long bottom;
+    _Atomic(tpd_buffer *) buffer;
+} tpd_deque;
+
+tpi_error tpd_init(tpd_deque *deque, size_t length);
+tpi_error tpd_push(tpd_deque *deque, tpi_task task);
+bool tpd_pop(tpd_deque *deque, tpi_task *task);
+bool tpd_steal(tpd_deque *deque, tpi_task *task);
+bool tpd_isempty(tpd_deque *deque);
+void tpd_destroy(tpd_deque *deque);
+
+#endif
@@ -0,0 +1,100 @@
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <unistd.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sys/eventfd.h>
+#include "tpdefs.h"
+#include "utilities.h"
+#include "event.h"
+
+tpi_error tpe_init(tpe_queue *queue) {
+    if ((queue->fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) < 0) {
+        return errno == ENOMEM ? TPI_ERROR_NOMEMORY : TPI_ERROR_SYSRES;
+    }
+    atomic_init(&queue->head, NULL);
+    atomic_init(&queue->outstanding, 0);
+    queue->pending = NULL;
+    return TPI_ERROR_OK;
+}
+
+tpe_entry * tpe_prepare(tpe_queue *queue, void *taskdata) {
+    tpe_entry *entry = malloc(sizeof(tpe_entry));
+    if (!entry) {
+        return NULL;
+    }
+    entry->next = NULL;
+    entry->queue = queue;
+    entry->taskdata = taskdata;
+    entry->result = 0;
+    entry->performed = false;
+    atomic_fetch_add_explicit(&queue->outstanding, 1, memory_order_relaxed);
+    return entry;
+}
+
+void tpe_release(tpe_entry *entry) {
+    atomic_fetch_sub_explicit(&entry->queue->outstanding, 1, memory_order_relaxed);
+    free(entry);
+}
+
+void tpe_signal(tpe_queue *queue) {
+    uint64_t one = 1;
+    while (write(queue->fd, &one, sizeof(one)) < 0 && errno == EINTR);
+}
+
+void tpe_post(tpe_entry *entry, bool performed, int result) {
+    tpe_queue *queue = entry->queue;
+    entry->performed = performed;
+    entry->result = result;
+    atomic_fetch_add_explicit(&queue->outstanding, 1, memory_order_relaxed);
+    tpe_entry *head = atomic_load_explicit(&queue->head, memory_order_relaxed);
+    do {
+        entry->next = head;
+    } while (!atomic_compare_exchange_weak_explicit(&queue->head, &head, entry, memory_order_release, memory_order_relaxed));
+    if (!head) {
+        tpe_signal(queue);
+    }
+    atomic_fetch_sub_explicit(&queue->outstanding, 1, memory_order_release);
+}
+
+void tpe_abandon(tpi_task task) {
+    if (task.extra && task.extra->event) {
+        tpe_post(task.extra->event, false, 0);
+    }
+}
+
+tpe_entry * tpe_take(tpe_queue *queue) {
+    if (!queue->pending) {
+        uint64_t count;
+        while (read(queue->fd, &count, sizeof(count)) < 0 && errno == EINTR);
+        tpe_entry *entry = atomic_exchange_explicit(&queue->head, NULL, memory_order_acquire);
+        while (entry) {
+            tpe_entry *next = entry->next;
+            entry->next = queue->pending;
+            queue->pending = entry;
+            entry = next;
+        }
+    }
+    tpe_entry *entry = queue->pending;
+    if (entry) {
+        queue->pending = entry->next;
+    }
+    return entry;
+}
+
+void tpe_rearm(tpe_queue *queue) {
+    if (queue->pending) {
+        tpe_signal(queue);
+    }
+}
+
+size_t tpe_outstanding(tpe_queue *queue) {
+    return atomic_load_explicit(&queue->outstanding, memory_order_acquire);
+}
+
+void tpe_destroy(tpe_queue *queue) {
+    close(queue->fd);
+    queue->fd = -1;
+}
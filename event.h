@@ -0,0 +1,31 @@
+#ifndef event_h
+#define event_h
+
+typedef struct tpe_queue tpe_queue;
+
+typedef struct tpe_entry {
+    struct tpe_entry *next;
+    tpe_queue *queue;
+    void *taskdata;
+    int result;
+    bool performed;
+} tpe_entry;
+
+struct tpe_queue {
+    int fd;
+    _Atomic(tpe_entry *) head;
+    tpe_entry *pending;
+    atomic_size_t outstanding;
+};
+
+tpi_error tpe_init(tpe_queue *queue);
+tpe_entry * tpe_prepare(tpe_queue *queue, void *taskdata);
+void tpe_release(tpe_entry *entry);
+void tpe_post(tpe_entry *entry, bool performed, int result);
+void tpe_abandon(tpi_task task);
+tpe_entry * tpe_take(tpe_queue *queue);
+void tpe_rearm(tpe_queue *queue);
+size_t tpe_outstanding(tpe_queue *queue);
+void tpe_destroy(tpe_queue *queue);
+
+#endif
@@ -0,0 +1,125 @@
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include "tpdefs.h"
+#include "group.h"
+#include "graph.h"
+
+tpi_error tpn_init(tpn_graph *graph) {
+    tpi_error error = tpg_init(&graph->group);
+    if (error) {
+        return error;
+    }
+    graph->nodes = NULL;
+    graph->count = 0;
+    graph->length = 0;
+    graph->validated = true;
+    graph->owner = NULL;
+    return TPI_ERROR_OK;
+}
+
+tpi_error tpn_add_node(tpn_graph *graph, int (* work)(void *, void *), void *taskdata, size_t *index) {
+    if (graph->count == graph->length) {
+        size_t length = graph->length ? graph->length * 2 : 16;
+        tpn_node *nodes = realloc(graph->nodes, length * sizeof(tpn_node));
+        if (!nodes) {
+            return TPI_ERROR_NOMEMORY;
+        }
+        graph->nodes = nodes;
+        graph->length = length;
+    }
+    tpn_node *node = &graph->nodes[graph->count];
+    node->work = work;
+    node->taskdata = taskdata;
+    node->successors = NULL;
+    node->num_successors = 0;
+    node->max_successors = 0;
+    node->predecessors = 0;
+    atomic_init(&node->remaining, 0);
+    atomic_init(&node->abandoned, false);
+    node->graph = graph;
+    * index = graph->count++;
+    return TPI_ERROR_OK;
+}
+
+tpi_error tpn_add_edge(tpn_graph *graph, size_t from, size_t to) {
+    tpn_node *node = &graph->nodes[from];
+    if (node->num_successors == node->max_successors) {
+        size_t length = node->max_successors ? node->max_successors * 2 : 4;
+        size_t *successors = realloc(node->successors, length * sizeof(size_t));
+        if (!successors) {
+            return TPI_ERROR_NOMEMORY;
+        }
+        node->successors = successors;
+        node->max_successors = length;
+    }
+    node->successors[node->num_successors++] = to;
+    graph->nodes[to].predecessors++;
+    graph->validated = false;
+    return TPI_ERROR_OK;
+}
+
+bool tpn_validate(tpn_graph *graph) {
+    if (graph->validated) {
+        return true;
+    }
+    size_t *pending = malloc(graph->count * sizeof(size_t));
+    size_t *ready = malloc(graph->count * sizeof(size_t));
+    if (!pending || !ready) {
+        free(pending);
+        free(ready);
+        return false;
+    }
+    size_t head = 0, tail = 0;
+    for (size_t i = 0; i < graph->count; i++) {
+        if ((pending[i] = graph->nodes[i].predecessors) == 0) {
+            ready[tail++] = i;
+        }
+    }
+    while (head < tail) {
+        tpn_node *node = &graph->nodes[ready[head++]];
+        for (size_t i = 0; i < node->num_successors; i++) {
+            if (--pending[node->successors[i]] == 0) {
+                ready[tail++] = node->successors[i];
+            }
+        }
+    }
+    free(pending);
+    free(ready);
+    graph->validated = tail == graph->count;
+    return graph->validated;
+}
+
+void tpn_reset(tpn_graph *graph, void *owner) {
+    graph->owner = owner;
+    for (size_t i = 0; i < graph->count; i++) {
+        atomic_store_explicit(&graph->nodes[i].remaining, graph->nodes[i].predecessors, memory_order_relaxed);
+        atomic_store_explicit(&graph->nodes[i].abandoned, false, memory_order_relaxed);
+    }
+    tpg_add(&graph->group, graph->count);
+}
+
+bool tpn_ready(tpn_graph *graph, size_t index) {
+    return atomic_fetch_sub_explicit(&graph->nodes[index].remaining, 1, memory_order_acq_rel) == 1;
+}
+
+size_t tpn_abandon(tpn_graph *graph, size_t index) {
+    tpn_node *node = &graph->nodes[index];
+    size_t settled = 0;
+    for (size_t i = 0; i < node->num_successors; i++) {
+        atomic_store_explicit(&graph->nodes[node->successors[i]].abandoned, true, memory_order_relaxed);
+        if (tpn_ready(graph, node->successors[i])) {
+            settled += 1 + tpn_abandon(graph, node->successors[i]);
+        }
+    }
+    return settled;
+}
+
+void tpn_destroy(tpn_graph *graph) {
+    for (size_t i = 0; i < graph->count; i++) {
+        free(graph->nodes[i].successors);
+    }
+    free(graph->nodes);
+    tpg_destroy(&graph->group);
+}
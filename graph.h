@@ -0,0 +1,36 @@
+#ifndef graph_h
+#define graph_h
+
+typedef struct tpn_graph tpn_graph;
+
+typedef struct {
+    int (* work)(void *taskdata, void *globaldata);
+    void *taskdata;
+    size_t *successors;
+    size_t num_successors;
+    size_t max_successors;
+    size_t predecessors;
+    atomic_size_t remaining;
+    atomic_bool abandoned;
+    tpn_graph *graph;
+} tpn_node;
+
+struct tpn_graph {
+    tpn_node *nodes;
+    size_t count;
+    size_t length;
+    tpg_group group;
+    bool validated;
+    void *owner;
+};
+
+tpi_error tpn_init(tpn_graph *graph);
+tpi_error tpn_add_node(tpn_graph *graph, int (* work)(void *, void *), void *taskdata, size_t *index);
+tpi_error tpn_add_edge(tpn_graph *graph, size_t from, size_t to);
+bool tpn_validate(tpn_graph *graph);
+void tpn_reset(tpn_graph *graph, void *owner);
+bool tpn_ready(tpn_graph *graph, size_t index);
+size_t tpn_abandon(tpn_graph *graph, size_t index);
+void tpn_destroy(tpn_graph *graph);
+
+#endif
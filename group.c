@@ -0,0 +1,91 @@
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <errno.h>
+#include <pthread.h>
+#include <time.h>
+#include "tpdefs.h"
+#include "utilities.h"
+#include "group.h"
+
+tpi_error tpg_init(tpg_group *group) {
+    int holder = 0;
+    if ((holder = pthread_mutex_init(&group->mutex, NULL))) {
+        return tpu_pthread_to_tpi(holder);
+    }
+    if ((holder = pthread_cond_init(&group->cond, NULL))) {
+        pthread_mutex_destroy(&group->mutex);
+        return tpu_pthread_to_tpi(holder);
+    }
+    atomic_init(&group->pending, 0);
+    atomic_init(&group->waiting, 0);
+    atomic_init(&group->cancelled, false);
+    return TPI_ERROR_OK;
+}
+
+void tpg_add(tpg_group *group, size_t count) {
+    atomic_fetch_add(&group->pending, count);
+}
+
+void tpg_settle(tpg_group *group, size_t count) {
+    size_t pending = atomic_load(&group->pending);
+    while (pending > count) {
+        if (atomic_compare_exchange_weak(&group->pending, &pending, pending - count)) {
+            return;
+        }
+    }
+    pthread_mutex_lock(&group->mutex);
+    if (atomic_fetch_sub(&group->pending, count) == count && atomic_load(&group->waiting)) {
+        pthread_cond_broadcast(&group->cond);
+    }
+    pthread_mutex_unlock(&group->mutex);
+}
+
+size_t tpg_pending(tpg_group *group) {
+    return atomic_load(&group->pending);
+}
+
+void tpg_wait(tpg_group *group) {
+    if (!atomic_load(&group->pending)) {
+        return;
+    }
+    pthread_mutex_lock(&group->mutex);
+    atomic_fetch_add(&group->waiting, 1);
+    while (atomic_load(&group->pending)) {
+        pthread_cond_wait(&group->cond, &group->mutex);
+    }
+    atomic_fetch_sub(&group->waiting, 1);
+    pthread_mutex_unlock(&group->mutex);
+}
+
+bool tpg_timedwait(tpg_group *group, size_t millis) {
+    if (!atomic_load(&group->pending)) {
+        return true;
+    }
+    struct timespec until = tpu_micro_timespec(millis * 1000);
+    int holder = 0;
+    pthread_mutex_lock(&group->mutex);
+    atomic_fetch_add(&group->waiting, 1);
+    while (atomic_load(&group->pending) && holder != ETIMEDOUT) {
+        holder = pthread_cond_timedwait(&group->cond, &group->mutex, &until);
+    }
+    atomic_fetch_sub(&group->waiting, 1);
+    bool result = !atomic_load(&group->pending);
+    pthread_mutex_unlock(&group->mutex);
+    return result;
+}
+
+void tpg_cancel(tpg_group *group) {
+    atomic_store(&group->cancelled, true);
+}
+
+bool tpg_iscancelled(tpg_group *group) {
+    return atomic_load_explicit(&group->cancelled, memory_order_relaxed);
+}
+
+void tpg_destroy(tpg_group *group) {
+    pthread_mutex_lock(&group->mutex);
+    pthread_mutex_unlock(&group->mutex);
+    pthread_cond_destroy(&group->cond);
+    pthread_mutex_destroy(&group->mutex);
+}
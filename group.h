@@ -0,0 +1,22 @@
+#ifndef group_h
+#define group_h
+
+typedef struct tpg_group {
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    atomic_size_t pending;
+    atomic_size_t waiting;
+    atomic_bool cancelled;
+} tpg_group;
+
+tpi_error tpg_init(tpg_group *group);
+void tpg_add(tpg_group *group, size_t count);
+void tpg_settle(tpg_group *group, size_t count);
+size_t tpg_pending(tpg_group *group);
+void tpg_wait(tpg_group *group);
+bool tpg_timedwait(tpg_group *group, size_t millis);
+void tpg_cancel(tpg_group *group);
+bool tpg_iscancelled(tpg_group *group);
+void tpg_destroy(tpg_group *group);
+
+#endif
@@ -0,0 +1,177 @@
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <errno.h>
+#include <pthread.h>
+#include <time.h>
+#include "tpdefs.h"
+#include "utilities.h"
+#include "handle.h"
+
+tpf_registry * tpf_registry_create() {
+    tpf_registry *registry = malloc(sizeof(tpf_registry));
+    if (!registry) {
+        return NULL;
+    }
+    if (pthread_mutex_init(&registry->mutex, NULL)) {
+        free(registry);
+        return NULL;
+    }
+    registry->free = NULL;
+    registry->outstanding = 0;
+    registry->closed = false;
+    return registry;
+}
+
+void tpf_registry_free(tpf_registry *registry) {
+    while (registry->free) {
+        tpf_handle *handle = registry->free;
+        registry->free = handle->next;
+        pthread_cond_destroy(&handle->cond);
+        pthread_mutex_destroy(&handle->mutex);
+        free(handle);
+    }
+}
+
+tpf_handle * tpf_create(tpf_registry *registry) {
+    tpf_handle *handle = malloc(sizeof(tpf_handle));
+    if (!handle) {
+        return NULL;
+    }
+    if (pthread_mutex_init(&handle->mutex, NULL)) {
+        free(handle);
+        return NULL;
+    }
+    if (pthread_cond_init(&handle->cond, NULL)) {
+        pthread_mutex_destroy(&handle->mutex);
+        free(handle);
+        return NULL;
+    }
+    handle->registry = registry;
+    return handle;
+}
+
+tpf_handle * tpf_acquire(tpf_registry *registry) {
+    pthread_mutex_lock(&registry->mutex);
+    tpf_handle *handle = registry->free;
+    if (handle) {
+        registry->free = handle->next;
+    }
+    registry->outstanding++;
+    pthread_mutex_unlock(&registry->mutex);
+    if (!handle && (handle = tpf_create(registry)) == NULL) {
+        pthread_mutex_lock(&registry->mutex);
+        registry->outstanding--;
+        pthread_mutex_unlock(&registry->mutex);
+        return NULL;
+    }
+    handle->next = NULL;
+    handle->result = 0;
+    atomic_init(&handle->state, TPF_STATE_PENDING);
+    atomic_init(&handle->refs, 2);
+    atomic_init(&handle->waiting, 0);
+    return handle;
+}
+
+void tpf_unref(tpf_handle *handle) {
+    if (atomic_fetch_sub(&handle->refs, 1) != 1) {
+        return;
+    }
+    tpf_registry *registry = handle->registry;
+    pthread_mutex_lock(&registry->mutex);
+    handle->next = registry->free;
+    registry->free = handle;
+    bool last = --registry->outstanding == 0 && registry->closed;
+    if (last) {
+        tpf_registry_free(registry);
+    }
+    pthread_mutex_unlock(&registry->mutex);
+    if (last) {
+        pthread_mutex_destroy(&registry->mutex);
+        free(registry);
+    }
+}
+
+bool tpf_claim(tpf_handle *handle) {
+    int expected = TPF_STATE_PENDING;
+    return atomic_compare_exchange_strong(&handle->state, &expected, TPF_STATE_RUNNING);
+}
+
+void tpf_signal(tpf_handle *handle) {
+    if (atomic_load(&handle->waiting)) {
+        pthread_mutex_lock(&handle->mutex);
+        pthread_cond_broadcast(&handle->cond);
+        pthread_mutex_unlock(&handle->mutex);
+    }
+}
+
+bool tpf_cancel(tpf_handle *handle) {
+    int expected = TPF_STATE_PENDING;
+    if (!atomic_compare_exchange_strong(&handle->state, &expected, TPF_STATE_DROPPED)) {
+        return false;
+    }
+    tpf_signal(handle);
+    return true;
+}
+
+void tpf_complete(tpf_handle *handle, tpf_state state, int result) {
+    handle->result = result;
+    atomic_store(&handle->state, state);
+    tpf_signal(handle);
+    tpf_unref(handle);
+}
+
+void tpf_abandon(tpi_task task) {
+    if (task.extra && task.extra->handle) {
+        tpf_complete(task.extra->handle, TPF_STATE_DROPPED, 0);
+    }
+}
+
+tpf_state tpf_state_of(tpf_handle *handle) {
+    return atomic_load_explicit(&handle->state, memory_order_acquire);
+}
+
+void tpf_wait(tpf_handle *handle) {
+    if (tpf_state_of(handle) >= TPF_STATE_DONE) {
+        return;
+    }
+    pthread_mutex_lock(&handle->mutex);
+    atomic_fetch_add(&handle->waiting, 1);
+    while (atomic_load(&handle->state) < TPF_STATE_DONE) {
+        pthread_cond_wait(&handle->cond, &handle->mutex);
+    }
+    atomic_fetch_sub(&handle->waiting, 1);
+    pthread_mutex_unlock(&handle->mutex);
+}
+
+bool tpf_timedwait(tpf_handle *handle, size_t millis) {
+    if (tpf_state_of(handle) >= TPF_STATE_DONE) {
+        return true;
+    }
+    struct timespec until = tpu_micro_timespec(millis * 1000);
+    int holder = 0;
+    pthread_mutex_lock(&handle->mutex);
+    atomic_fetch_add(&handle->waiting, 1);
+    while (atomic_load(&handle->state) < TPF_STATE_DONE && holder != ETIMEDOUT) {
+        holder = pthread_cond_timedwait(&handle->cond, &handle->mutex, &until);
+    }
+    atomic_fetch_sub(&handle->waiting, 1);
+    pthread_mutex_unlock(&handle->mutex);
+    return atomic_load(&handle->state) >= TPF_STATE_DONE;
+}
+
+void tpf_release(tpf_handle *handle) {
+    tpf_unref(handle);
+}
+
+void tpf_registry_close(tpf_registry *registry) {
+    pthread_mutex_lock(&registry->mutex);
+    registry->closed = true;
+    tpf_registry_free(registry);
+    bool last = registry->outstanding == 0;
+    pthread_mutex_unlock(&registry->mutex);
+    if (last) {
+        pthread_mutex_destroy(&registry->mutex);
+        free(registry);
+    }
+}
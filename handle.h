@@ -0,0 +1,43 @@
+#ifndef handle_h
+#define handle_h
+
+typedef enum {
+    TPF_STATE_PENDING = 0,
+    TPF_STATE_RUNNING,
+    TPF_STATE_DONE,
+    TPF_STATE_DROPPED
+} tpf_state;
+
+typedef struct tpf_registry tpf_registry;
+
+typedef struct tpf_handle {
+    struct tpf_handle *next;
+    tpf_registry *registry;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    atomic_int state;
+    atomic_uint refs;
+    atomic_size_t waiting;
+    int result;
+} tpf_handle;
+
+struct tpf_registry {
+    pthread_mutex_t mutex;
+    tpf_handle *free;
+    size_t outstanding;
+    bool closed;
+};
+
+tpf_registry * tpf_registry_create();
+tpf_handle * tpf_acquire(tpf_registry *registry);
+bool tpf_claim(tpf_handle *handle);
+bool tpf_cancel(tpf_handle *handle);
+void tpf_complete(tpf_handle *handle, tpf_state state, int result);
+void tpf_abandon(tpi_task task);
+tpf_state tpf_state_of(tpf_handle *handle);
+void tpf_wait(tpf_handle *handle);
+bool tpf_timedwait(tpf_handle *handle, size_t millis);
+void tpf_release(tpf_handle *handle);
+void tpf_registry_close(tpf_registry *registry);
+
+#endif
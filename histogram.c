@@ -0,0 +1,81 @@
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <string.h>
+#include "tpdefs.h"
+#include "histogram.h"
+
+void tph_init(tph_histogram *histogram) {
+    for (size_t i = 0; i < TPH_BUCKETS; i++) {
+        atomic_init(&histogram->counts[i], 0);
+    }
+    atomic_init(&histogram->max, 0);
+    bzero(histogram->baseline, sizeof(histogram->baseline));
+}
+
+size_t tph_index(unsigned long long value) {
+    if (value >> TPH_MAXBITS) {
+        value = (1ULL << TPH_MAXBITS) - 1;
+    }
+    if (value < TPH_SUBCOUNT) {
+        return value;
+    }
+    int shift = 63 - __builtin_clzll(value) - TPH_SUBBITS;
+    return (shift + 1) * TPH_SUBCOUNT + (value >> shift) - TPH_SUBCOUNT;
+}
+
+unsigned long long tph_highest(size_t index) {
+    size_t bucket = index >> TPH_SUBBITS;
+    unsigned long long sub = index & (TPH_SUBCOUNT - 1);
+    if (!bucket) {
+        return sub;
+    }
+    return ((sub + TPH_SUBCOUNT) << (bucket - 1)) + (1ULL << (bucket - 1)) - 1;
+}
+
+void tph_record(tph_histogram *histogram, unsigned long long value) {
+    atomic_ullong *count = &histogram->counts[tph_index(value)];
+    atomic_store_explicit(count, atomic_load_explicit(count, memory_order_relaxed) + 1, memory_order_relaxed);
+    unsigned long long max = atomic_load_explicit(&histogram->max, memory_order_relaxed);
+    while (max < value && !atomic_compare_exchange_weak_explicit(&histogram->max, &max, value, memory_order_relaxed, memory_order_relaxed));
+}
+
+void tph_collect(tph_histogram *histogram, unsigned long long *counts, unsigned long long *max, bool reset) {
+    for (size_t i = 0; i < TPH_BUCKETS; i++) {
+        unsigned long long current = atomic_load_explicit(&histogram->counts[i], memory_order_relaxed);
+        counts[i] += current - histogram->baseline[i];
+        if (reset) {
+            histogram->baseline[i] = current;
+        }
+    }
+    unsigned long long highest = reset ? atomic_exchange(&histogram->max, 0) : atomic_load(&histogram->max);
+    if (*max < highest) {
+        *max = highest;
+    }
+}
+
+tpi_latency tph_summarize(const unsigned long long *counts, unsigned long long max) {
+    static const unsigned long long permille[] = {500, 900, 990, 999};
+    unsigned long long values[4] = {0, 0, 0, 0};
+    unsigned long long total = 0;
+    for (size_t i = 0; i < TPH_BUCKETS; i++) {
+        total += counts[i];
+    }
+    unsigned long long seen = 0;
+    size_t next = 0;
+    for (size_t i = 0; i < TPH_BUCKETS && next < 4 && total; i++) {
+        seen += counts[i];
+        while (next < 4 && seen * 1000 >= total * permille[next]) {
+            values[next++] = tph_highest(i) < max ? tph_highest(i) : max;
+        }
+    }
+    tpi_latency latency = {
+        .samples = total,
+        .p50 = values[0],
+        .p90 = values[1],
+        .p99 = values[2],
+        .p999 = values[3],
+        .max = total ? max : 0
+    };
+    return latency;
+}
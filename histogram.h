@@ -0,0 +1,20 @@
+#ifndef histogram_h
+#define histogram_h
+
+#define TPH_SUBBITS 5
+#define TPH_SUBCOUNT (1 << TPH_SUBBITS)
+#define TPH_MAXBITS 44
+#define TPH_BUCKETS ((TPH_MAXBITS - TPH_SUBBITS + 1) * TPH_SUBCOUNT)
+
+typedef struct {
+    atomic_ullong counts[TPH_BUCKETS];
+    atomic_ullong max;
+    unsigned long long baseline[TPH_BUCKETS];
+} tph_histogram;
+
+void tph_init(tph_histogram *histogram);
+void tph_record(tph_histogram *histogram, unsigned long long value);
+void tph_collect(tph_histogram *histogram, unsigned long long *counts, unsigned long long *max, bool reset);
+tpi_latency tph_summarize(const unsigned long long *counts, unsigned long long max);
+
+#endif
@@ -0,0 +1,149 @@
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <string.h>
+#include <pthread.h>
+#include "tpdefs.h"
+#include "group.h"
+#include "parallel.h"
+
+tpi_error tpp_loop_init(tpp_loop *loop, size_t begin, size_t end, size_t grain, size_t participants, tpp_body body, void *context) {
+    tpi_error error = tpg_init(&loop->group);
+    if (error) {
+        return error;
+    }
+    tpg_add(&loop->group, end - begin);
+    atomic_init(&loop->next, begin);
+    atomic_init(&loop->joined, 0);
+    loop->end = end;
+    loop->grain = grain ? grain : 1;
+    loop->participants = participants ? participants : 1;
+    loop->body = body;
+    loop->context = context;
+    return TPI_ERROR_OK;
+}
+
+bool tpp_loop_claim(tpp_loop *loop, size_t *from, size_t *to) {
+    size_t start = atomic_load_explicit(&loop->next, memory_order_relaxed);
+    while (start < loop->end) {
+        size_t remaining = loop->end - start;
+        size_t chunk = remaining / (2 * loop->participants);
+        if (chunk < loop->grain) {
+            chunk = loop->grain;
+        }
+        if (chunk > remaining) {
+            chunk = remaining;
+        }
+        if (atomic_compare_exchange_weak_explicit(&loop->next, &start, start + chunk, memory_order_relaxed, memory_order_relaxed)) {
+            * from = start;
+            * to = start + chunk;
+            return true;
+        }
+    }
+    return false;
+}
+
+void tpp_loop_run(tpp_loop *loop) {
+    size_t from, to;
+    size_t participant = atomic_fetch_add_explicit(&loop->joined, 1, memory_order_relaxed);
+    while (tpp_loop_claim(loop, &from, &to)) {
+        loop->body(from, to, participant, loop->context);
+        tpg_settle(&loop->group, to - from);
+    }
+}
+
+int tpp_loop_helper(void *taskdata, void *globaldata) {
+    tpp_loop_run(taskdata);
+    return 0;
+}
+
+void tpp_loop_wait(tpp_loop *loop) {
+    tpg_wait(&loop->group);
+}
+
+void tpp_loop_destroy(tpp_loop *loop) {
+    tpg_destroy(&loop->group);
+}
+
+void tpp_range_body(size_t from, size_t to, size_t participant, void *context) {
+    tpp_range *range = context;
+    range->body(from, to, range->context);
+}
+
+void tpp_scan_sum_body(size_t from, size_t to, size_t participant, void *context) {
+    tpp_fold *fold = context;
+    for (size_t block = from; block < to; block++) {
+        unsigned char *sum = fold->blocks + block * fold->stride;
+        size_t first = block * fold->blocklength;
+        size_t last = first + fold->blocklength < fold->count ? first + fold->blocklength : fold->count;
+        memcpy(sum, fold->identity, fold->size);
+        for (size_t i = first; i < last; i++) {
+            fold->combine(sum, fold->input + i * fold->size, fold->context);
+        }
+    }
+}
+
+void tpp_scan_apply_body(size_t from, size_t to, size_t participant, void *context) {
+    tpp_fold *fold = context;
+    unsigned char *running = fold->partials + participant * fold->stride;
+    for (size_t block = from; block < to; block++) {
+        size_t first = block * fold->blocklength;
+        size_t last = first + fold->blocklength < fold->count ? first + fold->blocklength : fold->count;
+        memcpy(running, fold->blocks + block * fold->stride, fold->size);
+        for (size_t i = first; i < last; i++) {
+            fold->combine(running, fold->input + i * fold->size, fold->context);
+            memcpy(fold->output + i * fold->size, running, fold->size);
+        }
+    }
+}
+
+void tpp_sort_runs_body(size_t from, size_t to, size_t participant, void *context) {
+    tpp_sort *sort = context;
+    for (size_t run = from; run < to; run++) {
+        size_t first = run * sort->run;
+        size_t length = first + sort->run < sort->count ? sort->run : sort->count - first;
+        qsort(sort->source + first * sort->size, length, sort->size, sort->compare);
+    }
+}
+
+size_t tpp_corank(tpp_sort *sort, size_t rank, const unsigned char *left, size_t m, const unsigned char *right, size_t n) {
+    size_t low = rank > n ? rank - n : 0;
+    size_t high = rank < m ? rank : m;
+    while (low < high) {
+        size_t i = low + (high - low) / 2;
+        size_t j = rank - i;
+        if (j > 0 && sort->compare(left + i * sort->size, right + (j - 1) * sort->size) <= 0) {
+            low = i + 1;
+        } else {
+            high = i;
+        }
+    }
+    return low;
+}
+
+void tpp_sort_merge_body(size_t from, size_t to, size_t participant, void *context) {
+    tpp_sort *sort = context;
+    size_t size = sort->size;
+    for (size_t task = from; task < to; task++) {
+        size_t pair = task / sort->pieces;
+        size_t piece = task % sort->pieces;
+        size_t low = pair * 2 * sort->run;
+        size_t middle = low + sort->run < sort->count ? low + sort->run : sort->count;
+        size_t high = middle + sort->run < sort->count ? middle + sort->run : sort->count;
+        const unsigned char *left = sort->source + low * size;
+        const unsigned char *right = sort->source + middle * size;
+        size_t m = middle - low, n = high - middle;
+        size_t begin = (m + n) * piece / sort->pieces;
+        size_t end = (m + n) * (piece + 1) / sort->pieces;
+        size_t i = tpp_corank(sort, begin, left, m, right, n);
+        size_t j = begin - i;
+        unsigned char *out = sort->target + (low + begin) * size;
+        for (size_t k = begin; k < end; k++, out += size) {
+            if (j >= n || (i < m && sort->compare(left + i * size, right + j * size) <= 0)) {
+                memcpy(out, left + i++ * size, size);
+            } else {
+                memcpy(out, right + j++ * size, size);
+            }
+        }
+    }
+}
@@ -0,0 +1,60 @@
+#ifndef parallel_h
+#define parallel_h
+
+#define TPP_SORT_CUTOFF 4096
+
+typedef void (* tpp_body)(size_t from, size_t to, size_t participant, void *context);
+
+typedef struct {
+    tpg_group group;
+    atomic_size_t next;
+    atomic_size_t joined;
+    size_t end;
+    size_t grain;
+    size_t participants;
+    tpp_body body;
+    void *context;
+} tpp_loop;
+
+typedef struct {
+    void (* body)(size_t begin, size_t end, void *context);
+    void *context;
+} tpp_range;
+
+typedef struct {
+    const unsigned char *input;
+    unsigned char *output;
+    size_t count;
+    size_t size;
+    size_t stride;
+    size_t blocklength;
+    unsigned char *partials;
+    unsigned char *blocks;
+    const void *identity;
+    void (* combine)(void *accumulator, const void *element, void *context);
+    void *context;
+} tpp_fold;
+
+typedef struct {
+    unsigned char *source;
+    unsigned char *target;
+    size_t count;
+    size_t size;
+    size_t run;
+    size_t pieces;
+    int (* compare)(const void *, const void *);
+} tpp_sort;
+
+tpi_error tpp_loop_init(tpp_loop *loop, size_t begin, size_t end, size_t grain, size_t participants, tpp_body body, void *context);
+bool tpp_loop_claim(tpp_loop *loop, size_t *from, size_t *to);
+void tpp_loop_run(tpp_loop *loop);
+int tpp_loop_helper(void *taskdata, void *globaldata);
+void tpp_loop_wait(tpp_loop *loop);
+void tpp_loop_destroy(tpp_loop *loop);
+void tpp_range_body(size_t from, size_t to, size_t participant, void *context);
+void tpp_scan_sum_body(size_t from, size_t to, size_t participant, void *context);
+void tpp_scan_apply_body(size_t from, size_t to, size_t participant, void *context);
+void tpp_sort_runs_body(size_t from, size_t to, size_t participant, void *context);
+void tpp_sort_merge_body(size_t from, size_t to, size_t participant, void *context);
+
+#endif
@@ -1,11 +1,90 @@
 #include <stdlib.h>
+#include <stdint.h>
 #include <stdbool.h>
+#include <stdatomic.h>
+#include <string.h>
+#include <errno.h>
 #include <pthread.h>
 #include "tpdefs.h"
-#include "counting.h"
 #include "utilities.h"
+#include "histogram.h"
+#include "counting.h"
 #include "queue.h"
 
+void tpq_ring_init(tpq_ring *ring, tpq_cell *cells, size_t length) {
+    for (size_t i = 0; i < length; i++) {
+        atomic_init(&cells[i].sequence, i);
+    }
+    atomic_init(&ring->enqueue_at, 0);
+    atomic_init(&ring->dequeue_at, 0);
+    ring->mask = length - 1;
+    ring->cells = cells;
+}
+
+tpq_ring * tpq_ring_create(size_t length) {
+    tpq_ring *ring = tpu_aligned_calloc(1, sizeof(tpq_ring));
+    if (!ring) {
+        return NULL;
+    }
+    length = tpu_next_pow2(length);
+    tpq_cell *cells = calloc(length, sizeof(tpq_cell));
+    if (!cells) {
+        free(ring);
+        return NULL;
+    }
+    tpq_ring_init(ring, cells, length);
+    return ring;
+}
+
+bool tpq_ring_push(tpq_ring *ring, tpi_task task) {
+    size_t position = atomic_load_explicit(&ring->enqueue_at, memory_order_relaxed);
+    tpq_cell *cell;
+    while (true) {
+        cell = &ring->cells[position & ring->mask];
+        size_t sequence = atomic_load_explicit(&cell->sequence, memory_order_acquire);
+        intptr_t difference = (intptr_t) sequence - (intptr_t) position;
+        if (difference == 0) {
+            if (atomic_compare_exchange_weak_explicit(&ring->enqueue_at, &position, position + 1, memory_order_relaxed, memory_order_relaxed)) {
+                break;
+            }
+        } else if (difference < 0) {
+            return false;
+        } else {
+            position = atomic_load_explicit(&ring->enqueue_at, memory_order_relaxed);
+        }
+    }
+    cell->task = task;
+    atomic_store_explicit(&cell->sequence, position + 1, memory_order_release);
+    return true;
+}
+
+bool tpq_ring_pop(tpq_ring *ring, tpi_task *task) {
+    size_t position = atomic_load_explicit(&ring->dequeue_at, memory_order_relaxed);
+    tpq_cell *cell;
+    while (true) {
+        cell = &ring->cells[position & ring->mask];
+        size_t sequence = atomic_load_explicit(&cell->sequence, memory_order_acquire);
+        intptr_t difference = (intptr_t) sequence - (intptr_t) (position + 1);
+        if (difference == 0) {
+            if (atomic_compare_exchange_weak_explicit(&ring->dequeue_at, &position, position + 1, memory_order_relaxed, memory_order_relaxed)) {
+                break;
+            }
+        } else if (difference < 0) {
+            return false;
+        } else {
+            position = atomic_load_explicit(&ring->dequeue_at, memory_order_relaxed);
+        }
+    }
+    * task = cell->task;
+    atomic_store_explicit(&cell->sequence, position + ring->mask + 1, memory_order_release);
+    return true;
+}
+
+void tpq_ring_destroy(tpq_ring *ring) {
+    free(ring->cells);
+    free(ring);
+}
+
 tpi_error tpq_init(tpq_queue *queue, tpq_config config) {
     int holder = 0;
     if ((holder = pthread_mutex_init(&queue->mutex, NULL))) {
@@ -15,16 +94,61 @@ tpi_error tpq_init(tpq_queue *queue, tpq_config config) {
         pthread_mutex_destroy(&queue->mutex);
         return tpu_pthread_to_tpi(holder);
     }
-    if ((queue->list = calloc(config.initial_size, sizeof(tpi_task))) == NULL && config.initial_size) {
+    if ((holder = pthread_mutex_init(&queue->gate, NULL))) {
+        pthread_cond_destroy(&queue->cond);
+        pthread_mutex_destroy(&queue->mutex);
+        return tpu_pthread_to_tpi(holder);
+    }
+    if ((holder = pthread_cond_init(&queue->space, NULL))) {
+        pthread_mutex_destroy(&queue->gate);
+        pthread_cond_destroy(&queue->cond);
+        pthread_mutex_destroy(&queue->mutex);
+        return tpu_pthread_to_tpi(holder);
+    }
+    queue->ring = NULL;
+    if (config.schedule == TPI_SCHEDULE_LOCKFREE) {
+        if ((queue->ring = tpq_ring_create(config.initial_size < 2 ? 2 : config.initial_size)) == NULL) {
+            pthread_cond_destroy(&queue->space);
+            pthread_mutex_destroy(&queue->gate);
+            pthread_cond_destroy(&queue->cond);
+            pthread_mutex_destroy(&queue->mutex);
+            return TPI_ERROR_NOMEMORY;
+        }
+        queue->minimum = 0;
+    } else {
+        queue->minimum = config.initial_size ? tpu_next_pow2(config.initial_size) : 0;
+    }
+    if ((queue->list = calloc(queue->minimum, sizeof(tpi_task))) == NULL && queue->minimum) {
+        pthread_cond_destroy(&queue->space);
+        pthread_mutex_destroy(&queue->gate);
         pthread_cond_destroy(&queue->cond);
         pthread_mutex_destroy(&queue->mutex);
         return TPI_ERROR_NOMEMORY;
     }
     queue->manifest = config.manifest;
-    queue->schedule = config.schedule == TPI_SCHEDULE_DEFAULT ? TPI_SCHEDULE_FIFO : config.schedule;
+    switch (config.schedule) {
+        case TPI_SCHEDULE_DEFAULT:
+        case TPI_SCHEDULE_WORKSTEALING:
+            queue->schedule = TPI_SCHEDULE_FIFO;
+            break;
+        default:
+            queue->schedule = config.schedule;
+            break;
+    }
     queue->instruction = TPI_INSTR_PROCEED;
+    atomic_init(&queue->paused, false);
+    atomic_init(&queue->sleeping, 0);
+    atomic_init(&queue->spilled, 0);
+    atomic_init(&queue->depth, 0);
+    atomic_init(&queue->blocked, 0);
+    queue->limit = config.limit;
+    queue->resize_limit = config.resize_limit;
+    queue->resize_increment = config.resize_increment;
+    queue->aging = config.aging;
+    queue->ticket = 0;
+    queue->head = 0;
     queue->count = 0;
-    queue->length = config.initial_size;
+    queue->length = queue->minimum;
     return TPI_ERROR_OK;
 }
 
@@ -36,67 +160,314 @@ void tpq_release(tpq_queue *queue) {
     pthread_mutex_unlock(&queue->mutex);
 }
 
-tpi_error tpq_enqueue(tpq_queue *queue, tpi_task task) {
-    if (queue->count < queue->length) {
-        queue->list[queue->count] = task;
-        queue->count++;
-    } else {
-        size_t nc = queue->count + queue->resize_increment;
-        tpi_task *nl = calloc(nc, sizeof(tpi_task));
-        if (!nl) {
-            return TPI_ERROR_NOMEMORY;
+bool tpq_relocate(tpq_queue *queue, size_t length) {
+    tpi_task *nl = NULL;
+    if (length) {
+        if ((nl = malloc(length * sizeof(tpi_task))) == NULL) {
+            return false;
+        }
+        size_t first = queue->length - queue->head;
+        if (queue->count < first) {
+            first = queue->count;
+        }
+        memcpy(nl, queue->list + queue->head, first * sizeof(tpi_task));
+        memcpy(nl + first, queue->list, (queue->count - first) * sizeof(tpi_task));
+    }
+    free(queue->list);
+    queue->list = nl;
+    queue->length = length;
+    queue->head = 0;
+    return true;
+}
+
+tpi_error tpq_reserve(tpq_queue *queue, size_t count) {
+    size_t needed = queue->count + count;
+    if (needed <= queue->length) {
+        return TPI_ERROR_OK;
+    }
+    size_t nc = queue->length * 2;
+    if (nc < queue->length + queue->resize_increment) {
+        nc = queue->length + queue->resize_increment;
+    }
+    if (nc < needed) {
+        nc = needed;
+    }
+    return tpq_relocate(queue, tpu_next_pow2(nc)) ? TPI_ERROR_OK : TPI_ERROR_NOMEMORY;
+}
+
+bool tpq_precedes(tpq_queue *queue, tpi_task *a, tpi_task *b) {
+    int first = a->extra ? a->extra->priority : 0;
+    int second = b->extra ? b->extra->priority : 0;
+    if (queue->schedule == TPI_SCHEDULE_DEADLINE || queue->aging || first == second) {
+        return a->order < b->order;
+    }
+    return first > second;
+}
+
+void tpq_swap(tpi_task *a, tpi_task *b) {
+    tpi_task temp = *a;
+    * a = *b;
+    * b = temp;
+}
+
+void tpq_siftup(tpq_queue *queue, size_t index) {
+    while (index) {
+        size_t parent = (index - 1) / 2;
+        if (!tpq_precedes(queue, &queue->list[index], &queue->list[parent])) {
+            break;
         }
-        for (size_t i = 0; i < queue->count; i++) {
-            nl[i] = queue->list[i];
+        tpq_swap(&queue->list[index], &queue->list[parent]);
+        index = parent;
+    }
+}
+
+void tpq_siftdown(tpq_queue *queue, size_t index) {
+    while (true) {
+        size_t best = index;
+        size_t left = 2 * index + 1;
+        size_t right = left + 1;
+        if (left < queue->count && tpq_precedes(queue, &queue->list[left], &queue->list[best])) {
+            best = left;
         }
-        nl[queue->count] = task;
-        free(queue->list);
-        queue->count++;
-        queue->length = nc;
-        queue->list = nl;
+        if (right < queue->count && tpq_precedes(queue, &queue->list[right], &queue->list[best])) {
+            best = right;
+        }
+        if (best == index) {
+            break;
+        }
+        tpq_swap(&queue->list[index], &queue->list[best]);
+        index = best;
+    }
+}
+
+tpi_error tpq_append(tpq_queue *queue, tpi_task task) {
+    tpi_error error = tpq_reserve(queue, 1);
+    if (error) {
+        return error;
+    }
+    if (queue->schedule == TPI_SCHEDULE_PRIORITY || queue->schedule == TPI_SCHEDULE_DEADLINE) {
+        if (queue->schedule == TPI_SCHEDULE_DEADLINE) {
+            unsigned long long deadline = task.extra ? task.extra->deadline : 0;
+            task.order = deadline ? (long long) deadline : TPQ_UNBOUNDED + queue->ticket++;
+        } else if (queue->aging) {
+            task.order = (long long) tpu_nanotime() - (long long) queue->aging * (task.extra ? task.extra->priority : 0);
+        } else {
+            task.order = queue->ticket++;
+        }
+        queue->list[queue->count] = task;
+        tpq_siftup(queue, queue->count++);
+        return TPI_ERROR_OK;
+    }
+    queue->list[(queue->head + queue->count) & (queue->length - 1)] = task;
+    queue->count++;
+    if (queue->ring) {
+        atomic_fetch_add(&queue->spilled, 1);
     }
-    tpc_manifest_increment(queue->manifest, TPC_TARGET_QUEUED);
-    pthread_cond_signal(&queue->cond);
     return TPI_ERROR_OK;
 }
 
-bool tpq_extract(tpq_queue *queue, tpi_task *task) {
-    if (queue->count == 0) {
-        return false;
+void tpq_remove(tpq_queue *queue, tpi_task *task) {
+    size_t mask = queue->length - 1;
+    if (queue->schedule == TPI_SCHEDULE_PRIORITY || queue->schedule == TPI_SCHEDULE_DEADLINE) {
+        * task = queue->list[0];
+        queue->list[0] = queue->list[queue->count - 1];
+    } else if (queue->schedule == TPI_SCHEDULE_ROUNDROBIN) {
+        size_t index = (queue->head + tpu_get_random_index(queue->count)) & mask;
+        * task = queue->list[index];
+        queue->list[index] = queue->list[queue->head];
+        queue->head = (queue->head + 1) & mask;
+    } else {
+        * task = queue->list[queue->head];
+        queue->head = (queue->head + 1) & mask;
     }
-    size_t index = queue->schedule == TPI_SCHEDULE_FIFO ? 0 : tpu_get_random_index(queue->count);
-    * task = queue->list[index];
     queue->count--;
-    for (size_t i = index; i < queue->count; i++) {
-        queue->list[i] = queue->list[i + 1];
+    if (queue->schedule == TPI_SCHEDULE_PRIORITY || queue->schedule == TPI_SCHEDULE_DEADLINE) {
+        tpq_siftdown(queue, 0);
     }
-    if (queue->resize_limit <= queue->length - queue->count) {
-        if (queue->count == 0) {
-            free(queue->list);
-            queue->length = 0;
+    if (queue->ring) {
+        atomic_fetch_sub(&queue->spilled, 1);
+    }
+    if (queue->minimum < queue->length && queue->count <= queue->length / 4) {
+        if (queue->resize_limit <= queue->length - queue->count) {
+            tpq_relocate(queue, queue->length / 2);
+        }
+    }
+}
+
+size_t tpq_purge(tpq_queue *queue, bool (* match)(tpi_task *, void *), void (* drop)(tpi_task, void *), void *context) {
+    size_t mask = queue->length - 1;
+    size_t kept = 0;
+    for (size_t i = 0; i < queue->count; i++) {
+        tpi_task *task = &queue->list[(queue->head + i) & mask];
+        if (match(task, context)) {
+            drop(*task, context);
         } else {
-            tpi_task *nl = calloc(queue->count, sizeof(tpi_task));
-            if (nl) {
-                for (size_t i = 0; i < queue->count; i++) {
-                    nl[i] = queue->list[i];
-                }
-                free(queue->list);
-                queue->list = nl;
-                queue->length = queue->count;
-            }
+            queue->list[(queue->head + kept++) & mask] = *task;
+        }
+    }
+    size_t removed = queue->count - kept;
+    queue->count = kept;
+    if (queue->ring) {
+        atomic_fetch_sub(&queue->spilled, removed);
+    }
+    if (removed && (queue->schedule == TPI_SCHEDULE_PRIORITY || queue->schedule == TPI_SCHEDULE_DEADLINE)) {
+        for (size_t i = queue->count / 2; i-- > 0;) {
+            tpq_siftdown(queue, i);
+        }
+    }
+    return removed;
+}
+
+size_t tpq_tombstone(tpq_queue *queue, bool (* match)(tpi_task *, void *), void *context) {
+    size_t mask = queue->length - 1;
+    size_t marked = 0;
+    for (size_t i = 0; i < queue->count; i++) {
+        tpi_task *task = &queue->list[(queue->head + i) & mask];
+        if (!task->cancelled && match(task, context)) {
+            task->cancelled = true;
+            marked++;
+        }
+    }
+    tpq_vacate(queue, marked);
+    return marked;
+}
+
+bool tpq_pop(tpq_queue *queue, tpi_task *task) {
+    return queue->ring ? tpq_ring_pop(queue->ring, task) : false;
+}
+
+void tpq_wake(tpq_queue *queue, size_t count) {
+    size_t sleeping = atomic_load(&queue->sleeping);
+    if (sleeping == 0) {
+        return;
+    }
+    if (count == 1) {
+        pthread_cond_signal(&queue->cond);
+    } else if (sleeping <= count) {
+        pthread_cond_broadcast(&queue->cond);
+    } else {
+        while (count--) {
+            pthread_cond_signal(&queue->cond);
         }
     }
-    tpc_manifest_decrement(queue->manifest, TPC_TARGET_QUEUED);
+}
+
+bool tpq_take(tpq_queue *queue, tpi_task *task) {
+    if (!tpq_pop(queue, task)) {
+        if (queue->count == 0) {
+            return false;
+        }
+        tpq_remove(queue, task);
+    }
+    return true;
+}
+
+bool tpq_trytake(tpq_queue *queue, tpi_task *task) {
+    if (pthread_mutex_trylock(&queue->mutex)) {
+        return false;
+    }
+    bool taken = !queue->instruction && tpq_take(queue, task);
+    pthread_mutex_unlock(&queue->mutex);
+    return taken;
+}
+
+bool tpq_offer(tpq_queue *queue, tpi_task task) {
+    return !atomic_load(&queue->spilled) && tpq_ring_push(queue->ring, task);
+}
+
+void tpq_notify(tpq_queue *queue, size_t count) {
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load(&queue->sleeping)) {
+        tpq_acquire(queue);
+        tpq_wake(queue, count);
+        tpq_release(queue);
+    }
+}
+
+bool tpq_tryadmit(tpq_queue *queue, size_t count) {
+    size_t depth = atomic_load(&queue->depth);
+    do {
+        if (depth + count > queue->limit) {
+            return false;
+        }
+    } while (!atomic_compare_exchange_weak(&queue->depth, &depth, depth + count));
     return true;
 }
 
+bool tpq_admit(tpq_queue *queue, size_t count, bool bounded, size_t millis) {
+    if (!queue->limit || tpq_tryadmit(queue, count)) {
+        return true;
+    }
+    if (count > queue->limit || (bounded && !millis)) {
+        return false;
+    }
+    struct timespec until = tpu_micro_timespec(millis * 1000);
+    bool admitted = false;
+    pthread_mutex_lock(&queue->gate);
+    atomic_fetch_add(&queue->blocked, 1);
+    while (!(admitted = tpq_tryadmit(queue, count)) && !queue->instruction) {
+        if (!bounded) {
+            pthread_cond_wait(&queue->space, &queue->gate);
+        } else if (pthread_cond_timedwait(&queue->space, &queue->gate, &until) == ETIMEDOUT) {
+            admitted = tpq_tryadmit(queue, count);
+            break;
+        }
+    }
+    atomic_fetch_sub(&queue->blocked, 1);
+    pthread_mutex_unlock(&queue->gate);
+    return admitted;
+}
+
+void tpq_occupy(tpq_queue *queue, size_t count) {
+    if (queue->limit) {
+        atomic_fetch_add(&queue->depth, count);
+    }
+}
+
+void tpq_vacate(tpq_queue *queue, size_t count) {
+    if (!queue->limit || !count) {
+        return;
+    }
+    atomic_fetch_sub(&queue->depth, count);
+    size_t blocked = atomic_load(&queue->blocked);
+    if (blocked == 0) {
+        return;
+    }
+    pthread_mutex_lock(&queue->gate);
+    if (blocked <= count) {
+        pthread_cond_broadcast(&queue->space);
+    } else {
+        while (count--) {
+            pthread_cond_signal(&queue->space);
+        }
+    }
+    pthread_mutex_unlock(&queue->gate);
+}
+
+void tpq_unblock(tpq_queue *queue) {
+    pthread_mutex_lock(&queue->gate);
+    pthread_cond_broadcast(&queue->space);
+    pthread_mutex_unlock(&queue->gate);
+}
+
 void tpq_wait(tpq_queue *queue) {
     pthread_cond_wait(&queue->cond, &queue->mutex);
 }
 
+void tpq_timedwait(tpq_queue *queue, size_t micros) {
+    struct timespec until = tpu_micro_timespec(micros);
+    pthread_cond_timedwait(&queue->cond, &queue->mutex, &until);
+}
+
 void tpq_destroy(tpq_queue *queue) {
     pthread_mutex_destroy(&queue->mutex);
     pthread_cond_destroy(&queue->cond);
+    pthread_mutex_destroy(&queue->gate);
+    pthread_cond_destroy(&queue->space);
     free(queue->list);
-    queue->count = queue->length = 0;
-}
\ No newline at end of file
+    if (queue->ring) {
+        tpq_ring_destroy(queue->ring);
+        queue->ring = NULL;
+    }
+    queue->head = queue->count = queue->length = 0;
+}
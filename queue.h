@@ -1,33 +1,79 @@
 #ifndef queue_h
 #define queue_h
 
+#define TPQ_UNBOUNDED (LLONG_MAX / 2)
+
 typedef struct {
     tpc_manifest *manifest;
     tpi_schedule schedule;
     size_t initial_size;
     unsigned char resize_limit;
     unsigned char resize_increment;
+    unsigned long long aging;
+    size_t limit;
 } tpq_config;
 
+typedef struct {
+    atomic_size_t sequence;
+    tpi_task task;
+} tpq_cell;
+
+typedef struct {
+    _Alignas(TPU_CACHELINE) atomic_size_t enqueue_at;
+    _Alignas(TPU_CACHELINE) atomic_size_t dequeue_at;
+    _Alignas(TPU_CACHELINE) size_t mask;
+    tpq_cell *cells;
+} tpq_ring;
+
 typedef struct {
     pthread_mutex_t mutex;
     pthread_cond_t cond;
+    pthread_mutex_t gate;
+    pthread_cond_t space;
     tpc_manifest *manifest;
     tpi_schedule schedule;
     tpi_task *list;
+    tpq_ring *ring;
     tpi_instr instruction;
+    atomic_bool paused;
+    atomic_size_t sleeping;
+    atomic_size_t spilled;
+    atomic_size_t depth;
+    atomic_size_t blocked;
+    size_t limit;
     unsigned char resize_limit;
     unsigned char resize_increment;
+    size_t minimum;
+    unsigned long long aging;
+    long long ticket;
+    size_t head;
     size_t count;
     size_t length;
 } tpq_queue;
 
+void tpq_ring_init(tpq_ring *ring, tpq_cell *cells, size_t length);
+bool tpq_ring_push(tpq_ring *ring, tpi_task task);
+bool tpq_ring_pop(tpq_ring *ring, tpi_task *task);
 tpi_error tpq_init(tpq_queue *queue, tpq_config config);
 void tpq_acquire(tpq_queue *queue);
 void tpq_release(tpq_queue *queue);
-tpi_error tpq_enqueue(tpq_queue *queue, tpi_task task);
-bool tpq_extract(tpq_queue *queue, tpi_task *task);
+tpi_error tpq_reserve(tpq_queue *queue, size_t count);
+tpi_error tpq_append(tpq_queue *queue, tpi_task task);
+void tpq_wake(tpq_queue *queue, size_t count);
+size_t tpq_purge(tpq_queue *queue, bool (* match)(tpi_task *, void *), void (* drop)(tpi_task, void *), void *context);
+size_t tpq_tombstone(tpq_queue *queue, bool (* match)(tpi_task *, void *), void *context);
+bool tpq_take(tpq_queue *queue, tpi_task *task);
+bool tpq_trytake(tpq_queue *queue, tpi_task *task);
+bool tpq_offer(tpq_queue *queue, tpi_task task);
+bool tpq_pop(tpq_queue *queue, tpi_task *task);
+void tpq_notify(tpq_queue *queue, size_t count);
+bool tpq_tryadmit(tpq_queue *queue, size_t count);
+bool tpq_admit(tpq_queue *queue, size_t count, bool bounded, size_t millis);
+void tpq_occupy(tpq_queue *queue, size_t count);
+void tpq_vacate(tpq_queue *queue, size_t count);
+void tpq_unblock(tpq_queue *queue);
 void tpq_wait(tpq_queue *queue);
+void tpq_timedwait(tpq_queue *queue, size_t micros);
 void tpq_destroy(tpq_queue *queue);
 
 #endif
@@ -0,0 +1,140 @@
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <string.h>
+#include <time.h>
+#include "tpdefs.h"
+#include "utilities.h"
+#include "histogram.h"
+#include "counting.h"
+#include "sizing.h"
+
+tpz_sample tpz_controller_sample(tpz_controller *controller) {
+    tpc_manifest *manifest = controller->config.manifest;
+    tpi_stats stats = tpc_manifest_stats(manifest);
+    size_t timed = 0;
+    unsigned long long waited = 0;
+    tpc_manifest_waited(manifest, &timed, &waited);
+    unsigned long long now = tpu_nanotime();
+    double interval = (now - controller->stamp) / 1e9;
+    tpz_sample sample = {
+        .workers = stats.num_workers,
+        .busy = stats.num_busy,
+        .queued = stats.num_queued,
+        .throughput = interval > 0 ? (stats.num_complete - controller->complete) / interval : 0,
+        .wait = timed > controller->timed ? (waited - controller->waited) / 1e9 / (timed - controller->timed) : 0,
+        .interval = interval
+    };
+    controller->stamp = now;
+    controller->complete = stats.num_complete;
+    controller->timed = timed;
+    controller->waited = waited;
+    return sample;
+}
+
+int tpz_hillclimb(tpz_controller *controller, tpz_sample sample) {
+    int move;
+    if (!sample.queued) {
+        move = sample.busy < sample.workers ? -1 : 0;
+    } else if (controller->workers == sample.workers || controller->throughput <= 0) {
+        move = 1;
+    } else {
+        double gain = (sample.throughput - controller->throughput) / controller->throughput;
+        int last = sample.workers > controller->workers ? 1 : -1;
+        move = gain > TPZ_HYSTERESIS ? last : gain < -TPZ_HYSTERESIS ? -last : 0;
+    }
+    controller->workers = sample.workers;
+    controller->throughput = sample.throughput;
+    return move;
+}
+
+int tpz_latency(tpz_controller *controller, tpz_sample sample) {
+    double target = controller->config.target / 1e6;
+    if (sample.queued && sample.wait > target) {
+        return 1;
+    }
+    if (sample.wait < target / 2 && sample.busy < sample.workers) {
+        return -1;
+    }
+    return 0;
+}
+
+size_t tpz_controller_decide(tpz_controller *controller, tpz_sample sample) {
+    tpz_config *config = &controller->config;
+    size_t target = sample.workers;
+    switch (config->policy) {
+        case TPI_SIZING_DEMAND:
+            break;
+        case TPI_SIZING_HILLCLIMB:
+            target += tpz_hillclimb(controller, sample);
+            break;
+        case TPI_SIZING_LATENCY:
+            target += tpz_latency(controller, sample);
+            break;
+        case TPI_SIZING_CUSTOM:
+            target = config->custom(sample, config->context);
+            break;
+    }
+    if (target < config->minimum) {
+        return config->minimum;
+    }
+    return target > config->maximum ? config->maximum : target;
+}
+
+void * tpz_controller_routine(void *arg) {
+    tpz_controller *controller = arg;
+    pthread_mutex_lock(&controller->mutex);
+    while (!controller->stopping) {
+        struct timespec until = tpu_micro_timespec(controller->config.interval);
+        pthread_cond_timedwait(&controller->cond, &controller->mutex, &until);
+        if (controller->stopping) {
+            break;
+        }
+        pthread_mutex_unlock(&controller->mutex);
+        size_t target = tpz_controller_decide(controller, tpz_controller_sample(controller));
+        controller->config.apply(target, controller->config.context);
+        pthread_mutex_lock(&controller->mutex);
+    }
+    pthread_mutex_unlock(&controller->mutex);
+    return NULL;
+}
+
+tpi_error tpz_controller_start(tpz_controller *controller, tpz_config config) {
+    bzero(controller, sizeof(tpz_controller));
+    controller->config = config;
+    if (config.policy == TPI_SIZING_DEMAND) {
+        return TPI_ERROR_OK;
+    }
+    int holder = 0;
+    if ((holder = pthread_mutex_init(&controller->mutex, NULL))) {
+        return tpu_pthread_to_tpi(holder);
+    }
+    if ((holder = pthread_cond_init(&controller->cond, NULL))) {
+        pthread_mutex_destroy(&controller->mutex);
+        return tpu_pthread_to_tpi(holder);
+    }
+    controller->stamp = tpu_nanotime();
+    tpz_controller_sample(controller);
+    if ((holder = pthread_create(&controller->thread, NULL, &tpz_controller_routine, controller))) {
+        pthread_cond_destroy(&controller->cond);
+        pthread_mutex_destroy(&controller->mutex);
+        return tpu_pthread_to_tpi(holder);
+    }
+    controller->started = true;
+    return TPI_ERROR_OK;
+}
+
+void tpz_controller_stop(tpz_controller *controller) {
+    if (!controller->started) {
+        return;
+    }
+    pthread_mutex_lock(&controller->mutex);
+    controller->stopping = true;
+    pthread_cond_signal(&controller->cond);
+    pthread_mutex_unlock(&controller->mutex);
+    pthread_join(controller->thread, NULL);
+    pthread_cond_destroy(&controller->cond);
+    pthread_mutex_destroy(&controller->mutex);
+    controller->started = false;
+}
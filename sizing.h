@@ -0,0 +1,46 @@
+#ifndef sizing_h
+#define sizing_h
+
+#define TPZ_HYSTERESIS 0.05
+
+typedef struct {
+    size_t workers;
+    size_t busy;
+    size_t queued;
+    double throughput;
+    double wait;
+    double interval;
+} tpz_sample;
+
+typedef struct {
+    tpi_sizing policy;
+    size_t interval;
+    size_t target;
+    size_t minimum;
+    size_t maximum;
+    tpc_manifest *manifest;
+    size_t (* custom)(tpz_sample, void *);
+    void (* apply)(size_t, void *);
+    void *context;
+} tpz_config;
+
+typedef struct {
+    pthread_t thread;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    bool stopping;
+    bool started;
+    tpz_config config;
+    unsigned long long stamp;
+    size_t complete;
+    size_t timed;
+    unsigned long long waited;
+    size_t workers;
+    double throughput;
+} tpz_controller;
+
+tpi_error tpz_controller_start(tpz_controller *controller, tpz_config config);
+size_t tpz_controller_decide(tpz_controller *controller, tpz_sample sample);
+void tpz_controller_stop(tpz_controller *controller);
+
+#endif
@@ -0,0 +1,141 @@
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <string.h>
+#include <pthread.h>
+#include "tpdefs.h"
+#include "utilities.h"
+#include "slab.h"
+
+tpi_error tps_init(tps_slab *slab) {
+    int holder = 0;
+    if ((holder = pthread_mutex_init(&slab->mutex, NULL))) {
+        return tpu_pthread_to_tpi(holder);
+    }
+    bzero(&slab->depot, sizeof(tps_cache));
+    return TPI_ERROR_OK;
+}
+
+size_t tps_class(size_t size) {
+    size_t sizeclass = 0;
+    while (sizeclass < TPS_CLASSES && ((size_t) 1 << (TPS_MINSHIFT + sizeclass)) < size) {
+        sizeclass++;
+    }
+    return sizeclass;
+}
+
+tps_block * tps_take(tps_cache *cache, size_t sizeclass) {
+    tps_block *block = cache->free[sizeclass];
+    if (block) {
+        cache->free[sizeclass] = block->next;
+        cache->count[sizeclass]--;
+    }
+    return block;
+}
+
+void tps_put(tps_cache *cache, tps_block *block) {
+    block->next = cache->free[block->sizeclass];
+    cache->free[block->sizeclass] = block;
+    cache->count[block->sizeclass]++;
+}
+
+void * tps_alloc(tps_slab *slab, tps_cache *cache, size_t size) {
+    size_t sizeclass = tps_class(size);
+    tps_block *block = NULL;
+    if (sizeclass < TPS_CLASSES) {
+        if (cache && (block = tps_take(cache, sizeclass))) {
+            return block->data;
+        }
+        pthread_mutex_lock(&slab->mutex);
+        block = tps_take(&slab->depot, sizeclass);
+        for (size_t i = 1; cache && block && i < TPS_CACHELIMIT / 2 && slab->depot.free[sizeclass]; i++) {
+            tps_put(cache, tps_take(&slab->depot, sizeclass));
+        }
+        pthread_mutex_unlock(&slab->mutex);
+        if (block) {
+            return block->data;
+        }
+        size = (size_t) 1 << (TPS_MINSHIFT + sizeclass);
+    }
+    if ((block = malloc(sizeof(tps_block) + size)) == NULL) {
+        return NULL;
+    }
+    block->next = NULL;
+    block->sizeclass = sizeclass;
+    return block->data;
+}
+
+void tps_free(tps_slab *slab, tps_cache *cache, void *data) {
+    tps_block *block = (tps_block *) ((char *) data - offsetof(tps_block, data));
+    if (block->sizeclass == TPS_CLASSES) {
+        free(block);
+        return;
+    }
+    if (cache) {
+        tps_put(cache, block);
+        if (cache->count[block->sizeclass] <= TPS_CACHELIMIT) {
+            return;
+        }
+        size_t sizeclass = block->sizeclass;
+        pthread_mutex_lock(&slab->mutex);
+        while (TPS_CACHELIMIT / 2 < cache->count[sizeclass]) {
+            block = tps_take(cache, sizeclass);
+            if (slab->depot.count[sizeclass] < TPS_DEPOTLIMIT) {
+                tps_put(&slab->depot, block);
+            } else {
+                free(block);
+            }
+        }
+        pthread_mutex_unlock(&slab->mutex);
+        return;
+    }
+    pthread_mutex_lock(&slab->mutex);
+    if (slab->depot.count[block->sizeclass] < TPS_DEPOTLIMIT) {
+        tps_put(&slab->depot, block);
+        block = NULL;
+    }
+    pthread_mutex_unlock(&slab->mutex);
+    free(block);
+}
+
+void * tps_share(tps_slab *slab, tps_cache *cache, size_t size, size_t refs) {
+    max_align_t *base = tps_alloc(slab, cache, sizeof(max_align_t) + size);
+    if (!base) {
+        return NULL;
+    }
+    atomic_init((atomic_size_t *) base, refs);
+    return base + 1;
+}
+
+void tps_unshare(tps_slab *slab, tps_cache *cache, void *data, size_t refs) {
+    max_align_t *base = (max_align_t *) data - 1;
+    if (atomic_fetch_sub((atomic_size_t *) base, refs) == refs) {
+        tps_free(slab, cache, base);
+    }
+}
+
+void tps_discard(tps_slab *slab, tps_cache *cache, tpi_task task) {
+    if (task.extra) {
+        tps_unshare(slab, cache, task.extra, 1);
+    }
+    if (task.storage == TPI_STORAGE_SLAB) {
+        tps_free(slab, cache, task.taskdata);
+    } else if (task.storage == TPI_STORAGE_SHARED) {
+        tps_unshare(slab, cache, task.taskdata, 1);
+    }
+}
+
+void tps_clear(tps_cache *cache) {
+    for (size_t i = 0; i < TPS_CLASSES; i++) {
+        tps_block *block;
+        while ((block = tps_take(cache, i))) {
+            free(block);
+        }
+    }
+}
+
+void tps_destroy(tps_slab *slab) {
+    tps_clear(&slab->depot);
+    pthread_mutex_destroy(&slab->mutex);
+}
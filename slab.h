@@ -0,0 +1,34 @@
+#ifndef slab_h
+#define slab_h
+
+#define TPS_CLASSES 6
+#define TPS_MINSHIFT 7
+#define TPS_CACHELIMIT 32
+#define TPS_DEPOTLIMIT 1024
+
+typedef struct tps_block {
+    struct tps_block *next;
+    size_t sizeclass;
+    max_align_t data[];
+} tps_block;
+
+typedef struct {
+    tps_block *free[TPS_CLASSES];
+    size_t count[TPS_CLASSES];
+} tps_cache;
+
+typedef struct {
+    pthread_mutex_t mutex;
+    tps_cache depot;
+} tps_slab;
+
+tpi_error tps_init(tps_slab *slab);
+void * tps_alloc(tps_slab *slab, tps_cache *cache, size_t size);
+void tps_free(tps_slab *slab, tps_cache *cache, void *data);
+void * tps_share(tps_slab *slab, tps_cache *cache, size_t size, size_t refs);
+void tps_unshare(tps_slab *slab, tps_cache *cache, void *data, size_t refs);
+void tps_discard(tps_slab *slab, tps_cache *cache, tpi_task task);
+void tps_clear(tps_cache *cache);
+void tps_destroy(tps_slab *slab);
+
+#endif
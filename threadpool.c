@@ -5,12 +5,24 @@
 #include <errno.h>
 #include <pthread.h>
 #include <string.h>
+#include <stdint.h>
 #include <stdbool.h>
+#include <stdatomic.h>
 #include "threadpool.h"
 #include "tpdefs.h"
 #include "utilities.h"
+#include "histogram.h"
 #include "counting.h"
 #include "queue.h"
+#include "deque.h"
+#include "slab.h"
+#include "handle.h"
+#include "group.h"
+#include "sizing.h"
+#include "timer.h"
+#include "event.h"
+#include "graph.h"
+#include "parallel.h"
 #include "worker.h"
 
 #define TP_ERRMESSAGE_OK "No error occurred."
@@ -27,6 +39,11 @@
 #define TP_ERRMESSAGE_LOCKEDELSEWHERE "The threadpool has been locked but the calling thread may not unlock it."
 #define TP_ERRMESSAGE_TIMEOUT "The wait time specified for an event has passed without the event occurring."
 #define TP_ERRMESSAGE_ZEROWAITING "Blocking until the number of waiting threads is zero is not supported."
+#define TP_ERRMESSAGE_NOTCOMPLETE "The referenced work has not completed yet."
+#define TP_ERRMESSAGE_NOTPERFORMED "The task referenced by the handle was dropped without being performed."
+#define TP_ERRMESSAGE_CANCELLED "The task group has been cancelled and accepts no further tasks."
+#define TP_ERRMESSAGE_QUEUEFULL "The queue has reached its maximum depth and the task was not enqueued."
+#define TP_ERRMESSAGE_UNSUPPORTED "The operation is not supported by the pool's queue configuration."
 #define TP_ERRMESSAGE_UNKNOWN "An error has occurred but the reason for it is unknown."
 
 #define TP_EVALMESSAGE_OK "The tp_config is valid and may be used to construct a tp_threadpool."
@@ -39,6 +56,9 @@
 #define TP_EVALMESSAGE_TOOMANYTHREADS "The specified maximum number of threads exceeds a system imposed maximum."
 #define TP_EVALMESSAGE_QRESIZEZERO "One or both of the queue resize parameters is zero and therefore invalid."
 #define TP_EVALMESSAGE_PROCSCOPENSUP "The operating system does not support the TP_CONTENTIONSCOPE_PROCESS option."
+#define TP_EVALMESSAGE_BADSCHEDULE "The threadschedule specified is only valid as a queueschedule."
+#define TP_EVALMESSAGE_BADAFFINITY "The affinity cpus specified are not usable by this process."
+#define TP_EVALMESSAGE_BADSIZING "The sizing policy lacks an interval, a target wait, timing or a controller."
 
 bool tp_info_procscopeissupported() {
     pthread_attr_t attr;
@@ -130,7 +150,13 @@ tp_config tp_utils_defaultconfig() {
     tp_config config;
     config.api_version = TP_API_VERSION;
     config.contentionscope = TP_CONTENTIONSCOPE_DEFAULT;
+    config.affinity = TP_AFFINITY_NONE;
+    config.affinity_cpus = NULL;
+    config.num_affinity_cpus = 0;
+    config.numa = false;
     config.guardsize = getpagesize();
+    config.stack_arena = false;
+    config.stack_prefault = false;
     config.initial_queue = TP_DEFAULT_QUEUESIZE;
     config.min_threads = tp_info_hardwareconcurrency();
     config.more_threads = 0;
@@ -139,7 +165,20 @@ tp_config tp_utils_defaultconfig() {
     config.queueschedule = TP_SCHEDULE_DEFAULT;
     config.queue_resize_limit = TP_DEFAULT_RESIZELIMIT;
     config.queue_resize_increment = TP_DEFAULT_RESIZEINCREMENT;
+    config.priority_aging_micros = 0;
+    config.max_queued = 0;
+    config.idle_policy = TP_IDLE_BLOCK;
+    config.idle_spins = TP_DEFAULT_IDLESPINS;
+    config.idle_yields = TP_DEFAULT_IDLEYIELDS;
+    config.idle_keepalive_micros = TP_DEFAULT_KEEPALIVE;
+    config.sizing = TP_SIZING_DEMAND;
+    config.sizing_interval_micros = TP_DEFAULT_SIZINGINTERVAL;
+    config.target_wait_micros = TP_DEFAULT_TARGETWAIT;
+    config.sizing_controller = NULL;
+    config.timer_tick_micros = TP_DEFAULT_TIMERTICK;
     config.onstatschanged = NULL;
+    config.stats_interval_micros = 0;
+    config.disable_timing = false;
     config.ontaskfailed = NULL;
     config.userdata = NULL;
     return config;
@@ -179,6 +218,21 @@ tp_configeval tp_utils_evaluateconfig(tp_config config) {
             return TP_CONFIGEVAL_PROCSCOPENSUP;
         }
     }
+    if (config.threadschedule == TP_SCHEDULE_WORKSTEALING || config.threadschedule == TP_SCHEDULE_LOCKFREE || config.threadschedule == TP_SCHEDULE_PRIORITY || config.threadschedule == TP_SCHEDULE_DEADLINE) {
+        return TP_CONFIGEVAL_BADSCHEDULE;
+    }
+    if (config.affinity != TP_AFFINITY_NONE && !tpu_cpus_usable(config.affinity_cpus, config.num_affinity_cpus)) {
+        return TP_CONFIGEVAL_BADAFFINITY;
+    }
+    if (config.sizing != TP_SIZING_DEMAND && config.sizing_interval_micros == 0) {
+        return TP_CONFIGEVAL_BADSIZING;
+    }
+    if (config.sizing == TP_SIZING_LATENCY && (config.disable_timing || config.target_wait_micros == 0)) {
+        return TP_CONFIGEVAL_BADSIZING;
+    }
+    if (config.sizing == TP_SIZING_CUSTOM && config.sizing_controller == NULL) {
+        return TP_CONFIGEVAL_BADSIZING;
+    }
     return TP_CONFIGEVAL_OK;
 }
 
@@ -204,6 +258,12 @@ char * tp_utils_evalmessage(tp_configeval eval, char *buffer) {
             return strcpy(buffer, TP_EVALMESSAGE_TOOMANYTHREADS);
         case TP_CONFIGEVAL_WRONGVERSION:
             return strcpy(buffer, TP_EVALMESSAGE_WRONGVERSION);
+        case TP_CONFIGEVAL_BADSCHEDULE:
+            return strcpy(buffer, TP_EVALMESSAGE_BADSCHEDULE);
+        case TP_CONFIGEVAL_BADAFFINITY:
+            return strcpy(buffer, TP_EVALMESSAGE_BADAFFINITY);
+        case TP_CONFIGEVAL_BADSIZING:
+            return strcpy(buffer, TP_EVALMESSAGE_BADSIZING);
     }
 }
 
@@ -237,6 +297,16 @@ char * tp_utils_errormessage(tp_error error, char *buffer) {
             return strcpy(buffer, TP_ERRMESSAGE_TIMEOUT);
         case TP_ERROR_ZEROWAITING:
             return strcpy(buffer, TP_ERRMESSAGE_ZEROWAITING);
+        case TP_ERROR_NOTCOMPLETE:
+            return strcpy(buffer, TP_ERRMESSAGE_NOTCOMPLETE);
+        case TP_ERROR_NOTPERFORMED:
+            return strcpy(buffer, TP_ERRMESSAGE_NOTPERFORMED);
+        case TP_ERROR_CANCELLED:
+            return strcpy(buffer, TP_ERRMESSAGE_CANCELLED);
+        case TP_ERROR_QUEUEFULL:
+            return strcpy(buffer, TP_ERRMESSAGE_QUEUEFULL);
+        case TP_ERROR_UNSUPPORTED:
+            return strcpy(buffer, TP_ERRMESSAGE_UNSUPPORTED);
         case TP_ERROR_UNKNOWN:
             return strcpy(buffer, TP_ERRMESSAGE_UNKNOWN);
     }
@@ -253,12 +323,44 @@ clock_t tp_utils_sectoclock(double seconds) {
 struct tp_threadpool {
     tp_config config;
     tpc_manifest manifest;
+    tps_slab slab;
     tpq_queue queue;
     tpw_gen gen;
+    tpz_controller sizer;
+    tpt_wheel timers;
+    tpf_registry *handles;
     bool is_locked;
     bool is_running;
 };
 
+struct tp_group {
+    tpg_group group;
+    tp_threadpool *pool;
+};
+
+struct tp_graph {
+    tpn_graph graph;
+};
+
+struct tp_completions {
+    tpe_queue queue;
+};
+
+_Static_assert(TP_INLINE_MAXSIZE == TPI_INLINE_SIZE, "inline payload sizes must agree");
+_Static_assert(sizeof(tpi_task) <= TPU_CACHELINE, "a task slot must fit in one cache line");
+
+size_t tp_info_numanodes() {
+    size_t count = 0, found = 0;
+    size_t *nodes = tpu_numa_nodes(&count);
+    for (size_t i = 0; nodes && i < count; i++) {
+        size_t length = 0;
+        free(tpu_numa_cpus(nodes[i], &length));
+        found += length != 0;
+    }
+    free(nodes);
+    return found;
+}
+
 size_t tp_info_sizeofthreadpool() {
     return sizeof(tp_threadpool);
 }
@@ -267,6 +369,10 @@ bool tp_utils_statsareclear(tp_stats stats) {
     return stats.num_tasks_queued == 0 && stats.num_workers_waiting == stats.num_workers_total ? true : false;
 }
 
+unsigned long long tp_utils_nanotime() {
+    return tpu_nanotime();
+}
+
 tp_stats tpfromtpi_stats(tpi_stats stats) {
     tp_stats proc = {
         .num_workers_total = stats.num_workers,
@@ -274,7 +380,22 @@ tp_stats tpfromtpi_stats(tpi_stats stats) {
         .num_workers_waiting = stats.num_workers - stats.num_busy,
         .num_tasks_performed = stats.num_complete,
         .num_tasks_succeeded = stats.num_success,
-        .cpu_seconds = stats.cpu_time
+        .num_tasks_expired = stats.num_expired,
+        .num_tasks_cancelled = stats.num_cancelled,
+        .cpu_seconds = stats.cpu_time,
+        .wall_seconds = stats.wall_time
+    };
+    return proc;
+}
+
+tp_latency tpfromtpi_latency(tpi_latency latency) {
+    tp_latency proc = {
+        .num_samples = latency.samples,
+        .p50_seconds = latency.p50 / 1e9,
+        .p90_seconds = latency.p90 / 1e9,
+        .p99_seconds = latency.p99 / 1e9,
+        .p999_seconds = latency.p999 / 1e9,
+        .max_seconds = latency.max / 1e9
     };
     return proc;
 }
@@ -293,6 +414,10 @@ tp_error tpfromtpi_error(tpi_error error) {
             return TP_ERROR_SYSRES;
         case TPI_ERROR_TIMEOUT:
             return TP_ERROR_TIMEOUT;
+        case TPI_ERROR_QUEUEFULL:
+            return TP_ERROR_QUEUEFULL;
+        case TPI_ERROR_SHUTTINGDOWN:
+            return TP_ERROR_SHUTTINGDOWN;
         case TPI_ERROR_UNKNOWN:
             return TP_ERROR_UNKNOWN;
     }
@@ -306,6 +431,14 @@ tpi_schedule tpifromtp_schedule(tp_schedule schedule) {
             return TPI_SCHEDULE_FIFO;
         case TP_SCHEDULE_ROUNDROBIN:
             return TPI_SCHEDULE_ROUNDROBIN;
+        case TP_SCHEDULE_WORKSTEALING:
+            return TPI_SCHEDULE_WORKSTEALING;
+        case TP_SCHEDULE_LOCKFREE:
+            return TPI_SCHEDULE_LOCKFREE;
+        case TP_SCHEDULE_PRIORITY:
+            return TPI_SCHEDULE_PRIORITY;
+        case TP_SCHEDULE_DEADLINE:
+            return TPI_SCHEDULE_DEADLINE;
     }
 }
 
@@ -320,6 +453,69 @@ tpi_contentionscope tpifromtp_scope(tp_contentionscope scope) {
     }
 }
 
+tpi_affinity tpifromtp_affinity(tp_affinity affinity) {
+    switch (affinity) {
+        case TP_AFFINITY_NONE:
+            return TPI_AFFINITY_NONE;
+        case TP_AFFINITY_CPUSET:
+            return TPI_AFFINITY_CPUSET;
+        case TP_AFFINITY_PINNED:
+            return TPI_AFFINITY_PINNED;
+        case TP_AFFINITY_COMPACT:
+            return TPI_AFFINITY_COMPACT;
+        case TP_AFFINITY_SCATTER:
+            return TPI_AFFINITY_SCATTER;
+    }
+    return TPI_AFFINITY_NONE;
+}
+
+tpi_sizing tpifromtp_sizing(tp_sizing sizing) {
+    switch (sizing) {
+        case TP_SIZING_DEMAND:
+            return TPI_SIZING_DEMAND;
+        case TP_SIZING_HILLCLIMB:
+            return TPI_SIZING_HILLCLIMB;
+        case TP_SIZING_LATENCY:
+            return TPI_SIZING_LATENCY;
+        case TP_SIZING_CUSTOM:
+            return TPI_SIZING_CUSTOM;
+    }
+    return TPI_SIZING_DEMAND;
+}
+
+size_t tp_onsizing(tpz_sample sample, void *data) {
+    tp_threadpool *pool = data;
+    tp_sizing_sample converted = {
+        .num_workers = sample.workers,
+        .num_busy = sample.busy,
+        .num_queued = sample.queued,
+        .throughput = sample.throughput,
+        .mean_wait_seconds = sample.wait,
+        .interval_seconds = sample.interval
+    };
+    return pool->config.sizing_controller(pool, converted);
+}
+
+size_t tp_ontimer(tpi_task *tasks, size_t count, void *data);
+
+void tp_resize(size_t target, void *data) {
+    tp_threadpool *pool = data;
+    size_t previous = tpw_gen_setfloor(&pool->gen, target);
+    size_t workers = tpc_manifest_count(&pool->manifest, TPC_TARGET_WORKERS);
+    if (workers < target) {
+        tpi_error error = TPI_ERROR_OK;
+        tpc_manifest_acquire(&pool->manifest);
+        for (size_t i = target - workers; i && !error; i--) {
+            error = tpw_gen_generate(&pool->gen);
+        }
+        tpc_manifest_release(&pool->manifest);
+    } else if (workers > target && target < previous) {
+        tpq_acquire(&pool->queue);
+        tpq_wake(&pool->queue, workers - target);
+        tpq_release(&pool->queue);
+    }
+}
+
 void tp_onstatschanged(tpi_stats stats, void *data) {
     tp_threadpool *pool = data;
     if (pool->config.onstatschanged) {
@@ -343,8 +539,13 @@ tp_error tp_create(tp_threadpool **pool, tp_config config) {
     if (!holder) {
         return TP_ERROR_NOMEMORY;
     }
+    if ((holder->handles = tpf_registry_create()) == NULL) {
+        free(holder);
+        return TP_ERROR_NOMEMORY;
+    }
     tpi_error error;
-    if ((error = tpc_manifest_init(&holder->manifest, config.onstatschanged ? &tp_onstatschanged : NULL, holder))) {
+    if ((error = tpc_manifest_init(&holder->manifest, config.min_threads + config.more_threads, config.stats_interval_micros, config.onstatschanged ? &tp_onstatschanged : NULL, holder))) {
+        tpf_registry_close(holder->handles);
         free(holder);
         return tpfromtpi_error(error);
     }
@@ -353,43 +554,104 @@ tp_error tp_create(tp_threadpool **pool, tp_config config) {
         .schedule = tpifromtp_schedule(config.queueschedule),
         .initial_size = config.initial_queue,
         .resize_limit = config.queue_resize_limit,
-        .resize_increment = config.queue_resize_increment
+        .resize_increment = config.queue_resize_increment,
+        .aging = config.priority_aging_micros * 1000ULL,
+        .limit = config.max_queued
     };
+    if ((error = tps_init(&holder->slab))) {
+        tpc_manifest_destroy(&holder->manifest);
+        tpf_registry_close(holder->handles);
+        free(holder);
+        return tpfromtpi_error(error);
+    }
     if ((error = tpq_init(&holder->queue, qconfig))) {
+        tps_destroy(&holder->slab);
         tpc_manifest_destroy(&holder->manifest);
+        tpf_registry_close(holder->handles);
         free(holder);
         return tpfromtpi_error(error);
     }
     tpw_gen_config gconfig = {
         .stacksize = config.stacksize,
         .guardsize = config.guardsize,
+        .arena = config.stack_arena,
+        .prefault = config.stack_prefault,
         .schedule = tpifromtp_schedule(config.threadschedule),
         .scope = tpifromtp_scope(config.contentionscope),
+        .affinity = tpifromtp_affinity(config.affinity),
+        .cpus = config.affinity_cpus,
+        .num_cpus = config.num_affinity_cpus,
+        .numa = config.numa && config.queueschedule != TP_SCHEDULE_ROUNDROBIN && config.queueschedule != TP_SCHEDULE_PRIORITY && config.queueschedule != TP_SCHEDULE_DEADLINE,
+        .nodesize = config.initial_queue,
         .queue = &holder->queue,
+        .slab = &holder->slab,
         .minthreads = config.min_threads,
+        .maxthreads = config.min_threads + config.more_threads,
+        .spins = config.idle_policy == TP_IDLE_SPIN ? config.idle_spins : 0,
+        .yields = config.idle_policy == TP_IDLE_SPIN ? config.idle_yields : 0,
+        .keepalive = config.idle_keepalive_micros,
+        .stealing = config.queueschedule == TP_SCHEDULE_WORKSTEALING,
+        .timed = !config.disable_timing,
         .ontaskfailed = config.ontaskfailed ? &tp_ontaskfailed : NULL,
         .g_data = holder,
         .userdata = config.userdata
     };
     if ((error = tpw_gen_init(&holder->gen, gconfig))) {
         tpq_destroy(&holder->queue);
+        tps_destroy(&holder->slab);
+        tpc_manifest_destroy(&holder->manifest);
+        tpf_registry_close(holder->handles);
+        free(holder);
+        return tpfromtpi_error(error);
+    }
+    if ((error = tpt_wheel_init(&holder->timers, (config.timer_tick_micros ? config.timer_tick_micros : TP_DEFAULT_TIMERTICK) * 1000ULL, &tp_ontimer, holder))) {
+        tpw_gen_destory(&holder->gen);
+        tpq_destroy(&holder->queue);
+        tps_destroy(&holder->slab);
         tpc_manifest_destroy(&holder->manifest);
+        tpf_registry_close(holder->handles);
         free(holder);
         return tpfromtpi_error(error);
     }
     holder->is_locked = false;
     holder->is_running = true;
     holder->config = config;
+    bzero(&holder->sizer, sizeof(tpz_controller));
     for (size_t i = 0; i < config.min_threads; i++) {
         if ((error = tpw_gen_generate(&holder->gen))) {
             tp_shutdown(holder);
+            tpt_wheel_destroy(&holder->timers);
             tpw_gen_destory(&holder->gen);
             tpq_destroy(&holder->queue);
+            tps_destroy(&holder->slab);
             tpc_manifest_destroy(&holder->manifest);
+            tpf_registry_close(holder->handles);
             free(holder);
             return tpfromtpi_error(error);
         }
     }
+    tpz_config zconfig = {
+        .policy = tpifromtp_sizing(config.sizing),
+        .interval = config.sizing_interval_micros,
+        .target = config.target_wait_micros,
+        .minimum = config.min_threads,
+        .maximum = config.min_threads + config.more_threads,
+        .manifest = &holder->manifest,
+        .custom = &tp_onsizing,
+        .apply = &tp_resize,
+        .context = holder
+    };
+    if ((error = tpz_controller_start(&holder->sizer, zconfig))) {
+        tp_shutdown(holder);
+        tpt_wheel_destroy(&holder->timers);
+        tpw_gen_destory(&holder->gen);
+        tpq_destroy(&holder->queue);
+        tps_destroy(&holder->slab);
+        tpc_manifest_destroy(&holder->manifest);
+        tpf_registry_close(holder->handles);
+        free(holder);
+        return tpfromtpi_error(error);
+    }
     * pool = holder;
     return TP_ERROR_OK;
 }
@@ -399,10 +661,26 @@ tp_config tp_getconfig(tp_threadpool *pool) {
 }
 
 tp_stats tp_getstats(tp_threadpool *pool) {
-    tpc_manifest_acquire(&pool->manifest);
-    tp_stats stats = tpfromtpi_stats(tpc_manifest_stats(&pool->manifest));
-    tpc_manifest_release(&pool->manifest);
-    return stats;
+    return tpfromtpi_stats(tpc_manifest_stats(&pool->manifest));
+}
+
+tp_error tp_gethistograms(tp_threadpool *pool, bool reset, tp_histograms *histograms) {
+    if (pool == NULL || histograms == NULL) {
+        return TP_ERROR_BADARG;
+    }
+    tpi_latency waited, ran;
+    tpc_manifest_latency(&pool->manifest, reset, &waited, &ran);
+    histograms->queue_wait = tpfromtpi_latency(waited);
+    histograms->run_time = tpfromtpi_latency(ran);
+    return TP_ERROR_OK;
+}
+
+tp_error tp_getplacement(tp_threadpool *pool, int *cpus, size_t length, size_t *count) {
+    if (pool == NULL || (cpus == NULL && length) || count == NULL) {
+        return TP_ERROR_BADARG;
+    }
+    *count = tpw_gen_placement(&pool->gen, cpus, length);
+    return TP_ERROR_OK;
 }
 
 bool tp_isrunning(tp_threadpool *pool) {
@@ -414,54 +692,158 @@ bool tp_islocked(tp_threadpool *pool) {
 }
 
 bool tp_isclear(tp_threadpool *pool) {
-    tpc_manifest_acquire(&pool->manifest);
-    bool clear = tp_utils_statsareclear(tpfromtpi_stats(tpc_manifest_stats(&pool->manifest)));
-    tpc_manifest_release(&pool->manifest);
-    return clear;
+    return tp_utils_statsareclear(tpfromtpi_stats(tpc_manifest_stats(&pool->manifest)));
 }
 
 void * tp_userdata(tp_threadpool *pool) {
     return pool->config.userdata;
 }
 
-tp_error tp_enqueue(tp_threadpool *pool, tp_task task, void *taskdata, bool *wasenqueued) {
-    if (pool == NULL) {
-        return TP_ERROR_BADARG;
-    }
-    if (!pool->is_running) {
-        return TP_ERROR_ISSHUTDOWN;
-    }
-    if (pool->is_locked) {
-        return TP_ERROR_ISLOCKED;
+typedef struct {
+    tpi_task model;
+    void **taskdata;
+    const tp_entry *entries;
+    tpw_node *node;
+    const tpi_task *tasks;
+    const tpi_extra *extra;
+    bool forced;
+    bool bounded;
+    size_t millis;
+} tp_source;
+
+tpi_task tp_source_at(tp_source source, size_t index) {
+    tpi_task task = source.model;
+    if (source.tasks) {
+        task = source.tasks[index];
+        task.enqueued = source.model.enqueued;
+    } else if (source.entries) {
+        task.work = source.entries[index].task;
+        task.taskdata = source.entries[index].taskdata;
+    } else if (source.taskdata) {
+        task.taskdata = source.taskdata[index];
+    }
+    return task;
+}
+
+size_t tp_shortfall(tp_threadpool *pool, size_t demand) {
+    size_t max_threads = pool->config.min_threads + pool->config.more_threads;
+    size_t workers = tpc_manifest_count(&pool->manifest, TPC_TARGET_WORKERS);
+    size_t busy = tpc_manifest_count(&pool->manifest, TPC_TARGET_BUSY);
+    size_t idle = busy < workers ? workers - busy : 0;
+    if (max_threads <= workers || demand <= idle) {
+        return 0;
     }
-    if (pool->queue.instruction) {
-        return TP_ERROR_SHUTTINGDOWN;
+    return demand - idle < max_threads - workers ? demand - idle : max_threads - workers;
+}
+
+tpi_error tp_expand(tp_threadpool *pool, size_t demand) {
+    tpi_error error = TPI_ERROR_OK;
+    if (pool->config.sizing != TP_SIZING_DEMAND && tpc_manifest_count(&pool->manifest, TPC_TARGET_WORKERS)) {
+        return error;
+    }
+    if (tp_shortfall(pool, demand)) {
+        tpc_manifest_acquire(&pool->manifest);
+        for (size_t i = tp_shortfall(pool, demand); i && !error; i--) {
+            error = tpw_gen_generate(&pool->gen);
+        }
+        tpc_manifest_release(&pool->manifest);
     }
-    tpc_manifest_acquire(&pool->manifest);
-    tpq_acquire(&pool->queue);
-    tpi_task entry = {
-        .taskdata = taskdata,
-        .work = task
-    };
-    tpi_error error = tpq_enqueue(&pool->queue, entry);
-    if (error) {
-        *wasenqueued = false;
+    return error;
+}
+
+tpi_error tp_submit(tp_threadpool *pool, tp_source source, size_t count, size_t *enqueued) {
+    tpi_error error = TPI_ERROR_OK;
+    size_t done = 0;
+    if (source.forced || tpw_gen_ismember(&pool->gen)) {
+        tpq_occupy(&pool->queue, count);
+    } else if (!tpq_admit(&pool->queue, count, source.bounded, source.millis)) {
+        *enqueued = 0;
+        return pool->queue.instruction ? TPI_ERROR_SHUTTINGDOWN : TPI_ERROR_QUEUEFULL;
+    }
+    if (source.extra) {
+        tpi_extra *extra = tps_share(&pool->slab, tpw_gen_cache(&pool->gen), sizeof(tpi_extra), count);
+        if (extra == NULL) {
+            tpq_vacate(&pool->queue, count);
+            *enqueued = 0;
+            return TPI_ERROR_NOMEMORY;
+        }
+        *extra = *source.extra;
+        source.model.extra = extra;
+    }
+    tpw_worker *local = source.node ? NULL : tpw_gen_current(&pool->gen);
+    tpw_node *node = local ? NULL : source.node ? source.node : tpw_gen_local(&pool->gen);
+    source.model.enqueued = pool->config.disable_timing ? 0 : tpu_nanotime();
+    if (local || node || pool->queue.ring) {
+        tpc_manifest_quickadd(&pool->manifest, TPC_TARGET_QUEUED, count);
+        if (local) {
+            while (done < count && !(error = tpw_worker_push(local, tp_source_at(source, done)))) {
+                done++;
+            }
+        } else if (node) {
+            while (done < count && tpw_node_offer(node, tp_source_at(source, done))) {
+                done++;
+            }
+        } else {
+            while (done < count && tpq_offer(&pool->queue, tp_source_at(source, done))) {
+                done++;
+            }
+        }
+        if (done) {
+            tpq_notify(&pool->queue, done);
+        }
+        if (done < count && !local) {
+            tpq_acquire(&pool->queue);
+            if (!(error = tpq_reserve(&pool->queue, count - done))) {
+                size_t spilled = count - done;
+                for (; done < count; done++) {
+                    tpq_append(&pool->queue, tp_source_at(source, done));
+                }
+                tpq_wake(&pool->queue, spilled);
+            }
+            tpq_release(&pool->queue);
+        }
+        if (done < count) {
+            tpc_manifest_quicksubtract(&pool->manifest, TPC_TARGET_QUEUED, count - done);
+        }
+    } else {
+        tpq_acquire(&pool->queue);
+        tpc_manifest_acquire(&pool->manifest);
+        if (!(error = tpq_reserve(&pool->queue, count))) {
+            for (; done < count; done++) {
+                tpq_append(&pool->queue, tp_source_at(source, done));
+            }
+            tpc_manifest_add(&pool->manifest, TPC_TARGET_QUEUED, count);
+            tpq_wake(&pool->queue, count);
+        }
         tpc_manifest_release(&pool->manifest);
         tpq_release(&pool->queue);
-        return tpfromtpi_error(error);
     }
-    *wasenqueued = true;
-    size_t max_threads = pool->config.min_threads + pool->config.more_threads;
-    size_t waiting = pool->manifest.num_workers.count - pool->manifest.num_busy.count;
-    if (pool->manifest.num_workers.count < max_threads && waiting == 0) {
-        error = tpw_gen_generate(&pool->gen);
+    if (done < count) {
+        tpq_vacate(&pool->queue, count - done);
+        if (source.model.extra) {
+            tps_unshare(&pool->slab, tpw_gen_cache(&pool->gen), source.model.extra, count - done);
+        }
     }
-    tpc_manifest_release(&pool->manifest);
-    tpq_release(&pool->queue);
-    return tpfromtpi_error(error);
+    *enqueued = done;
+    if (done) {
+        tpi_error spawned = tp_expand(pool, done);
+        error = error ? error : spawned;
+    }
+    return error;
 }
 
-tp_error tp_waitforclear(tp_threadpool *pool) {
+size_t tp_ontimer(tpi_task *tasks, size_t count, void *data) {
+    tp_threadpool *pool = data;
+    tp_source source = {
+        .tasks = tasks,
+        .forced = true
+    };
+    size_t enqueued = 0;
+    tp_submit(pool, source, count, &enqueued);
+    return enqueued;
+}
+
+tp_error tp_enqueue(tp_threadpool *pool, tp_task task, void *taskdata, bool *wasenqueued) {
     if (pool == NULL) {
         return TP_ERROR_BADARG;
     }
@@ -474,14 +856,19 @@ tp_error tp_waitforclear(tp_threadpool *pool) {
     if (pool->queue.instruction) {
         return TP_ERROR_SHUTTINGDOWN;
     }
-    tpc_manifest_acquire(&pool->manifest);
-    tpc_manifest_waitfor(&pool->manifest, TPC_TARGET_QUEUED, TPC_EVENT_ZERO);
-    tpc_manifest_waitfor(&pool->manifest, TPC_TARGET_BUSY, TPC_EVENT_ZERO);
-    tpc_manifest_release(&pool->manifest);
-    return TP_ERROR_OK;
+    tp_source source = {
+        .model = {
+            .taskdata = taskdata,
+            .work = task
+        }
+    };
+    size_t enqueued = 0;
+    tpi_error error = tp_submit(pool, source, 1, &enqueued);
+    *wasenqueued = enqueued == 1;
+    return tpfromtpi_error(error);
 }
 
-tp_error tp_timedwaitforclear(tp_threadpool *pool, size_t millis) {
+tp_error tp_tryenqueue(tp_threadpool *pool, tp_task task, void *taskdata, bool *wasenqueued) {
     if (pool == NULL) {
         return TP_ERROR_BADARG;
     }
@@ -494,26 +881,20 @@ tp_error tp_timedwaitforclear(tp_threadpool *pool, size_t millis) {
     if (pool->queue.instruction) {
         return TP_ERROR_SHUTTINGDOWN;
     }
-    tpc_manifest_acquire(&pool->manifest);
-    size_t start = tpu_millitime();
-    if (!tpc_manifest_timedwaitfor(&pool->manifest, TPC_TARGET_QUEUED, TPC_EVENT_ZERO, millis)) {
-        tpc_manifest_release(&pool->manifest);
-        return TP_ERROR_TIMEOUT;
-    }
-    size_t remainder = millis - (tpu_millitime() - start);
-    if (millis < remainder) {
-        tpc_manifest_release(&pool->manifest);
-        return TP_ERROR_TIMEOUT;
-    }
-    if (!tpc_manifest_timedwaitfor(&pool->manifest, TPC_TARGET_BUSY, TPC_EVENT_ZERO, remainder)) {
-        tpc_manifest_release(&pool->manifest);
-        return TP_ERROR_TIMEOUT;
-    }
-    tpc_manifest_release(&pool->manifest);
-    return TP_ERROR_OK;
+    tp_source source = {
+        .model = {
+            .taskdata = taskdata,
+            .work = task
+        },
+        .bounded = true
+    };
+    size_t enqueued = 0;
+    tpi_error error = tp_submit(pool, source, 1, &enqueued);
+    *wasenqueued = enqueued == 1;
+    return tpfromtpi_error(error);
 }
 
-tp_error tp_waitforqempty(tp_threadpool *pool) {
+tp_error tp_timedenqueue(tp_threadpool *pool, tp_task task, void *taskdata, size_t millis, bool *wasenqueued) {
     if (pool == NULL) {
         return TP_ERROR_BADARG;
     }
@@ -526,13 +907,21 @@ tp_error tp_waitforqempty(tp_threadpool *pool) {
     if (pool->queue.instruction) {
         return TP_ERROR_SHUTTINGDOWN;
     }
-    tpc_manifest_acquire(&pool->manifest);
-    tpc_manifest_waitfor(&pool->manifest, TPC_TARGET_QUEUED, TPC_EVENT_ZERO);
-    tpc_manifest_release(&pool->manifest);
-    return TP_ERROR_OK;
+    tp_source source = {
+        .model = {
+            .taskdata = taskdata,
+            .work = task
+        },
+        .bounded = true,
+        .millis = millis
+    };
+    size_t enqueued = 0;
+    tpi_error error = tp_submit(pool, source, 1, &enqueued);
+    *wasenqueued = enqueued == 1;
+    return tpfromtpi_error(error);
 }
 
-tp_error tp_timedwaitforqempty(tp_threadpool *pool, size_t millis) {
+tp_error tp_enqueue_node(tp_threadpool *pool, size_t node, tp_task task, void *taskdata, bool *wasenqueued) {
     if (pool == NULL) {
         return TP_ERROR_BADARG;
     }
@@ -545,37 +934,24 @@ tp_error tp_timedwaitforqempty(tp_threadpool *pool, size_t millis) {
     if (pool->queue.instruction) {
         return TP_ERROR_SHUTTINGDOWN;
     }
-    tpc_manifest_acquire(&pool->manifest);
-    bool success = tpc_manifest_timedwaitfor(&pool->manifest, TPC_TARGET_QUEUED, TPC_EVENT_ZERO, millis);
-    tpc_manifest_release(&pool->manifest);
-    return success ? TP_ERROR_OK : TP_ERROR_TIMEOUT;
-}
-
-tpc_event tpcfromtp_change(tp_change change) {
-    switch (change) {
-        case TP_CHANGE_DECREMENT:
-            return TPC_EVENT_DECREMENT;
-        case TP_CHANGE_INCREMENT:
-            return TPC_EVENT_INCREMENT;
-        case TP_CHANGE_ZERO:
-            return TPC_EVENT_ZERO;
-    }
-}
-
-tpc_target tpcfromtp_component(tp_component component) {
-    switch (component) {
-        case TP_COMPONENT_BUSY:
-            return TPC_TARGET_BUSY;
-        case TP_COMPONENT_QUEUED:
-            return TPC_TARGET_QUEUED;
-        case TP_COMPONENT_WAITING:
-            return TPC_TARGET_BUSY;
-        case TP_COMPONENT_WORKERS:
-            return TPC_TARGET_WORKERS;
+    tpw_node *target = tpw_gen_node(&pool->gen, node);
+    if (!target && (pool->gen.num_nodes || node)) {
+        return TP_ERROR_BADARG;
     }
+    tp_source source = {
+        .model = {
+            .taskdata = taskdata,
+            .work = task
+        },
+        .node = target
+    };
+    size_t enqueued = 0;
+    tpi_error error = tp_submit(pool, source, 1, &enqueued);
+    *wasenqueued = enqueued == 1;
+    return tpfromtpi_error(error);
 }
 
-tp_error tp_waitforchange(tp_threadpool *pool, tp_component component, tp_change change) {
+tp_error tp_enqueue_priority(tp_threadpool *pool, tp_task task, void *taskdata, int priority, bool *wasenqueued) {
     if (pool == NULL) {
         return TP_ERROR_BADARG;
     }
@@ -588,27 +964,22 @@ tp_error tp_waitforchange(tp_threadpool *pool, tp_component component, tp_change
     if (pool->queue.instruction) {
         return TP_ERROR_SHUTTINGDOWN;
     }
-    tpc_target target = tpcfromtp_component(component);
-    tpc_event event = tpcfromtp_change(change);
-    if (component == TP_COMPONENT_WAITING) {
-        switch (change) {
-            case TP_CHANGE_DECREMENT:
-                event = TPC_EVENT_INCREMENT;
-                break;
-            case TP_CHANGE_INCREMENT:
-                event = TPC_EVENT_DECREMENT;
-                break;
-            case TP_CHANGE_ZERO:
-                return TP_ERROR_ZEROWAITING;
+    tp_source source = {
+        .model = {
+            .taskdata = taskdata,
+            .work = task
+        },
+        .extra = &(tpi_extra) {
+            .priority = priority
         }
-    }
-    tpc_manifest_acquire(&pool->manifest);
-    tpc_manifest_waitfor(&pool->manifest, target, event);
-    tpc_manifest_release(&pool->manifest);
-    return TP_ERROR_OK;
+    };
+    size_t enqueued = 0;
+    tpi_error error = tp_submit(pool, source, 1, &enqueued);
+    *wasenqueued = enqueued == 1;
+    return tpfromtpi_error(error);
 }
 
-tp_error tp_timedwaitforchange(tp_threadpool *pool, tp_component component, tp_change change, size_t millis) {
+tp_error tp_enqueue_deadline(tp_threadpool *pool, tp_task task, void *taskdata, unsigned long long deadline_ns, tp_expired on_expired, bool *wasenqueued) {
     if (pool == NULL) {
         return TP_ERROR_BADARG;
     }
@@ -621,28 +992,24 @@ tp_error tp_timedwaitforchange(tp_threadpool *pool, tp_component component, tp_c
     if (pool->queue.instruction) {
         return TP_ERROR_SHUTTINGDOWN;
     }
-    tpc_target target = tpcfromtp_component(component);
-    tpc_event event = tpcfromtp_change(change);
-    if (component == TP_COMPONENT_WAITING) {
-        switch (change) {
-            case TP_CHANGE_DECREMENT:
-                event = TPC_EVENT_INCREMENT;
-                break;
-            case TP_CHANGE_INCREMENT:
-                event = TPC_EVENT_DECREMENT;
-                break;
-            case TP_CHANGE_ZERO:
-                return TP_ERROR_ZEROWAITING;
+    tp_source source = {
+        .model = {
+            .taskdata = taskdata,
+            .work = task
+        },
+        .extra = &(tpi_extra) {
+            .deadline = deadline_ns,
+            .expired = on_expired
         }
-    }
-    tpc_manifest_acquire(&pool->manifest);
-    bool success = tpc_manifest_timedwaitfor(&pool->manifest, target, event, millis);
-    tpc_manifest_release(&pool->manifest);
-    return success ? TP_ERROR_OK : TP_ERROR_TIMEOUT;
+    };
+    size_t enqueued = 0;
+    tpi_error error = tp_submit(pool, source, 1, &enqueued);
+    *wasenqueued = enqueued == 1;
+    return tpfromtpi_error(error);
 }
 
-tp_error tp_lock(tp_threadpool *pool) {
-    if (pool == NULL) {
+tp_error tp_enqueue_handle(tp_threadpool *pool, tp_task task, void *taskdata, tp_handle **handle) {
+    if (pool == NULL || handle == NULL) {
         return TP_ERROR_BADARG;
     }
     if (!pool->is_running) {
@@ -654,30 +1021,1052 @@ tp_error tp_lock(tp_threadpool *pool) {
     if (pool->queue.instruction) {
         return TP_ERROR_SHUTTINGDOWN;
     }
-    tpq_acquire(&pool->queue);
-    pool->is_locked = true;
+    *handle = NULL;
+    tpi_extra extra = {
+        .handle = tpf_acquire(pool->handles)
+    };
+    if (extra.handle == NULL) {
+        return TP_ERROR_NOMEMORY;
+    }
+    tp_source source = {
+        .model = {
+            .taskdata = taskdata,
+            .work = task
+        },
+        .extra = &extra
+    };
+    size_t enqueued = 0;
+    tpi_error error = tp_submit(pool, source, 1, &enqueued);
+    if (enqueued == 0) {
+        tpf_release(extra.handle);
+        tpf_release(extra.handle);
+        return error ? tpfromtpi_error(error) : TP_ERROR_UNKNOWN;
+    }
+    *handle = (tp_handle *) extra.handle;
+    return tpfromtpi_error(error);
+}
+
+tp_error tp_handle_wait(tp_handle *handle) {
+    if (handle == NULL) {
+        return TP_ERROR_BADARG;
+    }
+    tpf_wait((tpf_handle *) handle);
     return TP_ERROR_OK;
 }
 
-tp_error tp_unlock(tp_threadpool *pool) {
-    if (pool == NULL) {
+tp_error tp_handle_timedwait(tp_handle *handle, size_t millis) {
+    if (handle == NULL) {
         return TP_ERROR_BADARG;
     }
-    if (!pool->is_running) {
-        return TP_ERROR_ISSHUTDOWN;
+    return tpf_timedwait((tpf_handle *) handle, millis) ? TP_ERROR_OK : TP_ERROR_TIMEOUT;
+}
+
+tp_error tp_handle_result(tp_handle *handle, int *result) {
+    if (handle == NULL || result == NULL) {
+        return TP_ERROR_BADARG;
     }
-    if (!pool->is_locked) {
-        return TP_ERROR_ISNOTLOCKED;
+    switch (tpf_state_of((tpf_handle *) handle)) {
+        case TPF_STATE_PENDING:
+        case TPF_STATE_RUNNING:
+            return TP_ERROR_NOTCOMPLETE;
+        case TPF_STATE_DROPPED:
+            return TP_ERROR_NOTPERFORMED;
+        default:
+            *result = ((tpf_handle *) handle)->result;
+            return TP_ERROR_OK;
     }
-    if (pool->queue.instruction) {
-        return TP_ERROR_SHUTTINGDOWN;
+}
+
+tp_error tp_handle_release(tp_handle *handle) {
+    if (handle == NULL) {
+        return TP_ERROR_BADARG;
     }
-    int result = pthread_mutex_unlock(&pool->queue.mutex);
-    switch (result) {
-        case 0:
-            pool->is_locked = false;
+    tpf_release((tpf_handle *) handle);
+    return TP_ERROR_OK;
+}
+
+typedef struct {
+    tp_predicate predicate;
+    void *context;
+} tp_filter;
+
+bool tp_filter_matches(tpi_task *task, void *context) {
+    tp_filter *filter = context;
+    if (task->internal || !filter->predicate(task->work, task->storage == TPI_STORAGE_INLINE ? task->payload : task->taskdata, filter->context)) {
+        return false;
+    }
+    return !task->extra || !task->extra->handle || tpf_cancel(task->extra->handle);
+}
+
+tp_error tp_cancel(tp_threadpool *pool, tp_handle *handle, bool *wascancelled) {
+    if (pool == NULL || handle == NULL || wascancelled == NULL) {
+        return TP_ERROR_BADARG;
+    }
+    if (((tpf_handle *) handle)->registry != pool->handles) {
+        return TP_ERROR_BADARG;
+    }
+    if (!pool->is_running) {
+        return TP_ERROR_ISSHUTDOWN;
+    }
+    *wascancelled = tpf_cancel((tpf_handle *) handle);
+    return TP_ERROR_OK;
+}
+
+tp_error tp_cancel_if(tp_threadpool *pool, tp_predicate predicate, void *context, size_t *cancelled) {
+    if (pool == NULL || predicate == NULL || cancelled == NULL) {
+        return TP_ERROR_BADARG;
+    }
+    if (!pool->is_running) {
+        return TP_ERROR_ISSHUTDOWN;
+    }
+    if (pool->queue.ring || pool->gen.num_nodes || pool->gen.stealing) {
+        return TP_ERROR_UNSUPPORTED;
+    }
+    tp_filter filter = {
+        .predicate = predicate,
+        .context = context
+    };
+    tpq_acquire(&pool->queue);
+    *cancelled = tpq_tombstone(&pool->queue, &tp_filter_matches, &filter);
+    tpq_release(&pool->queue);
+    return TP_ERROR_OK;
+}
+
+tp_error tp_schedule_timer(tp_threadpool *pool, tp_task task, void *taskdata, unsigned long long delay_ns, unsigned long long period_ns, tp_timer **timer) {
+    tpi_task model = {
+        .taskdata = taskdata,
+        .work = task
+    };
+    tpt_timer *holder = tpt_timer_create(model, timer != NULL);
+    if (!holder) {
+        return TP_ERROR_NOMEMORY;
+    }
+    tpi_error error = tpt_wheel_insert(&pool->timers, holder, delay_ns, period_ns);
+    if (error) {
+        free(holder);
+        return tpfromtpi_error(error);
+    }
+    if (timer) {
+        *timer = (tp_timer *) holder;
+    }
+    return TP_ERROR_OK;
+}
+
+tp_error tp_enqueue_after(tp_threadpool *pool, tp_task task, void *taskdata, unsigned long long delay_ns, tp_timer **timer) {
+    if (pool == NULL || task == NULL) {
+        return TP_ERROR_BADARG;
+    }
+    if (!pool->is_running) {
+        return TP_ERROR_ISSHUTDOWN;
+    }
+    if (pool->is_locked) {
+        return TP_ERROR_ISLOCKED;
+    }
+    if (pool->queue.instruction) {
+        return TP_ERROR_SHUTTINGDOWN;
+    }
+    return tp_schedule_timer(pool, task, taskdata, delay_ns, 0, timer);
+}
+
+tp_error tp_enqueue_periodic(tp_threadpool *pool, tp_task task, void *taskdata, unsigned long long period_ns, tp_timer **timer) {
+    if (pool == NULL || task == NULL || period_ns == 0) {
+        return TP_ERROR_BADARG;
+    }
+    if (!pool->is_running) {
+        return TP_ERROR_ISSHUTDOWN;
+    }
+    if (pool->is_locked) {
+        return TP_ERROR_ISLOCKED;
+    }
+    if (pool->queue.instruction) {
+        return TP_ERROR_SHUTTINGDOWN;
+    }
+    return tp_schedule_timer(pool, task, taskdata, period_ns, period_ns, timer);
+}
+
+tp_error tp_timer_cancel(tp_timer *timer, bool *wascancelled) {
+    if (timer == NULL || wascancelled == NULL) {
+        return TP_ERROR_BADARG;
+    }
+    *wascancelled = tpt_timer_cancel((tpt_timer *) timer);
+    return TP_ERROR_OK;
+}
+
+tp_error tp_timer_release(tp_timer *timer) {
+    if (timer == NULL) {
+        return TP_ERROR_BADARG;
+    }
+    tpt_timer_release((tpt_timer *) timer);
+    return TP_ERROR_OK;
+}
+
+size_t tp_timers_pending(tp_threadpool *pool) {
+    return tpt_wheel_pending(&pool->timers);
+}
+
+tp_error tp_group_create(tp_threadpool *pool, tp_group **group) {
+    if (pool == NULL || group == NULL) {
+        return TP_ERROR_BADARG;
+    }
+    tp_group *holder = malloc(sizeof(tp_group));
+    if (!holder) {
+        return TP_ERROR_NOMEMORY;
+    }
+    tpi_error error;
+    if ((error = tpg_init(&holder->group))) {
+        free(holder);
+        return tpfromtpi_error(error);
+    }
+    holder->pool = pool;
+    *group = holder;
+    return TP_ERROR_OK;
+}
+
+tp_error tp_enqueue_group(tp_group *group, tp_task task, void *taskdata, bool *wasenqueued) {
+    if (group == NULL) {
+        return TP_ERROR_BADARG;
+    }
+    tp_threadpool *pool = group->pool;
+    if (!pool->is_running) {
+        return TP_ERROR_ISSHUTDOWN;
+    }
+    if (pool->is_locked) {
+        return TP_ERROR_ISLOCKED;
+    }
+    if (pool->queue.instruction) {
+        return TP_ERROR_SHUTTINGDOWN;
+    }
+    if (tpg_iscancelled(&group->group)) {
+        return TP_ERROR_CANCELLED;
+    }
+    tp_source source = {
+        .model = {
+            .taskdata = taskdata,
+            .work = task
+        },
+        .extra = &(tpi_extra) {
+            .group = &group->group
+        }
+    };
+    tpg_add(&group->group, 1);
+    size_t enqueued = 0;
+    tpi_error error = tp_submit(pool, source, 1, &enqueued);
+    if (enqueued == 0) {
+        tpg_settle(&group->group, 1);
+    }
+    *wasenqueued = enqueued == 1;
+    return tpfromtpi_error(error);
+}
+
+tp_error tp_group_wait(tp_group *group) {
+    if (group == NULL) {
+        return TP_ERROR_BADARG;
+    }
+    tpg_wait(&group->group);
+    return TP_ERROR_OK;
+}
+
+tp_error tp_group_timedwait(tp_group *group, size_t millis) {
+    if (group == NULL) {
+        return TP_ERROR_BADARG;
+    }
+    return tpg_timedwait(&group->group, millis) ? TP_ERROR_OK : TP_ERROR_TIMEOUT;
+}
+
+bool tp_group_matches(tpi_task *task, void *context) {
+    return !task->cancelled && task->extra && task->extra->group == context;
+}
+
+void tp_group_drop(tpi_task task, void *context) {
+    tpw_discard(&((tp_group *) context)->pool->slab, NULL, task);
+}
+
+tp_error tp_group_cancel(tp_group *group) {
+    if (group == NULL) {
+        return TP_ERROR_BADARG;
+    }
+    tp_threadpool *pool = group->pool;
+    tpg_cancel(&group->group);
+    tpq_acquire(&pool->queue);
+    size_t removed = tpq_purge(&pool->queue, &tp_group_matches, &tp_group_drop, group);
+    tpq_release(&pool->queue);
+    if (removed) {
+        tpc_manifest_purge(&pool->manifest, removed);
+        tpq_vacate(&pool->queue, removed);
+    }
+    return TP_ERROR_OK;
+}
+
+tp_error tp_group_destroy(tp_group *group) {
+    if (group == NULL) {
+        return TP_ERROR_BADARG;
+    }
+    if (tpg_pending(&group->group)) {
+        return TP_ERROR_NOTCOMPLETE;
+    }
+    tpg_destroy(&group->group);
+    free(group);
+    return TP_ERROR_OK;
+}
+
+tp_error tp_completions_create(tp_completions **completions) {
+    if (completions == NULL) {
+        return TP_ERROR_BADARG;
+    }
+    tp_completions *holder = malloc(sizeof(tp_completions));
+    if (!holder) {
+        return TP_ERROR_NOMEMORY;
+    }
+    tpi_error error;
+    if ((error = tpe_init(&holder->queue))) {
+        free(holder);
+        return tpfromtpi_error(error);
+    }
+    *completions = holder;
+    return TP_ERROR_OK;
+}
+
+int tp_completions_fd(tp_completions *completions) {
+    return completions ? completions->queue.fd : -1;
+}
+
+tp_error tp_enqueue_completion(tp_threadpool *pool, tp_completions *completions, tp_task task, void *taskdata, bool *wasenqueued) {
+    if (pool == NULL || completions == NULL) {
+        return TP_ERROR_BADARG;
+    }
+    if (!pool->is_running) {
+        return TP_ERROR_ISSHUTDOWN;
+    }
+    if (pool->is_locked) {
+        return TP_ERROR_ISLOCKED;
+    }
+    if (pool->queue.instruction) {
+        return TP_ERROR_SHUTTINGDOWN;
+    }
+    tpe_entry *entry = tpe_prepare(&completions->queue, taskdata);
+    if (!entry) {
+        return TP_ERROR_NOMEMORY;
+    }
+    tp_source source = {
+        .model = {
+            .taskdata = taskdata,
+            .work = task
+        },
+        .extra = &(tpi_extra) {
+            .event = entry
+        }
+    };
+    size_t enqueued = 0;
+    tpi_error error = tp_submit(pool, source, 1, &enqueued);
+    if (enqueued == 0) {
+        tpe_release(entry);
+    }
+    *wasenqueued = enqueued == 1;
+    return tpfromtpi_error(error);
+}
+
+size_t tp_completions_drain(tp_completions *completions, tp_completion *results, size_t length) {
+    if (completions == NULL || results == NULL) {
+        return 0;
+    }
+    size_t count = 0;
+    tpe_entry *entry;
+    while (count < length && (entry = tpe_take(&completions->queue))) {
+        results[count].taskdata = entry->taskdata;
+        results[count].result = entry->result;
+        results[count].performed = entry->performed;
+        tpe_release(entry);
+        count++;
+    }
+    tpe_rearm(&completions->queue);
+    return count;
+}
+
+tp_error tp_completions_destroy(tp_completions *completions) {
+    if (completions == NULL) {
+        return TP_ERROR_BADARG;
+    }
+    if (tpe_outstanding(&completions->queue)) {
+        return TP_ERROR_NOTCOMPLETE;
+    }
+    tpe_destroy(&completions->queue);
+    free(completions);
+    return TP_ERROR_OK;
+}
+
+tp_error tp_graph_create(tp_graph **graph) {
+    if (graph == NULL) {
+        return TP_ERROR_BADARG;
+    }
+    tp_graph *holder = malloc(sizeof(tp_graph));
+    if (!holder) {
+        return TP_ERROR_NOMEMORY;
+    }
+    tpi_error error;
+    if ((error = tpn_init(&holder->graph))) {
+        free(holder);
+        return tpfromtpi_error(error);
+    }
+    *graph = holder;
+    return TP_ERROR_OK;
+}
+
+tp_error tp_graph_addnode(tp_graph *graph, tp_task task, void *taskdata, size_t *node) {
+    if (graph == NULL || task == NULL || node == NULL) {
+        return TP_ERROR_BADARG;
+    }
+    if (tpg_pending(&graph->graph.group)) {
+        return TP_ERROR_NOTCOMPLETE;
+    }
+    return tpfromtpi_error(tpn_add_node(&graph->graph, task, taskdata, node));
+}
+
+tp_error tp_graph_addedge(tp_graph *graph, size_t from, size_t to) {
+    if (graph == NULL || from >= graph->graph.count || to >= graph->graph.count || from == to) {
+        return TP_ERROR_BADARG;
+    }
+    if (tpg_pending(&graph->graph.group)) {
+        return TP_ERROR_NOTCOMPLETE;
+    }
+    return tpfromtpi_error(tpn_add_edge(&graph->graph, from, to));
+}
+
+void tp_graph_launch(tp_threadpool *pool, tpn_node *node);
+
+int tp_graph_perform(void *taskdata, void *userdata) {
+    tpn_node *node = taskdata;
+    tpn_graph *graph = node->graph;
+    int result = node->work(node->taskdata, userdata);
+    if (result) {
+        tp_ontaskfailed(result, node->taskdata, graph->owner);
+    }
+    for (size_t i = 0; i < node->num_successors; i++) {
+        if (!tpn_ready(graph, node->successors[i])) {
+            continue;
+        }
+        if (atomic_load_explicit(&graph->nodes[node->successors[i]].abandoned, memory_order_relaxed)) {
+            tpg_settle(&graph->group, 1 + tpn_abandon(graph, node->successors[i]));
+        } else {
+            tp_graph_launch(graph->owner, &graph->nodes[node->successors[i]]);
+        }
+    }
+    return result;
+}
+
+void tp_graph_drop(void *taskdata) {
+    tpn_node *node = taskdata;
+    size_t settled = tpn_abandon(node->graph, (size_t) (node - node->graph->nodes));
+    if (settled) {
+        tpg_settle(&node->graph->group, settled);
+    }
+}
+
+void tp_graph_launch(tp_threadpool *pool, tpn_node *node) {
+    tp_source source = {
+        .model = {
+            .taskdata = node,
+            .work = &tp_graph_perform,
+            .internal = true
+        },
+        .extra = &(tpi_extra) {
+            .dropped = &tp_graph_drop,
+            .group = &node->graph->group
+        }
+    };
+    size_t enqueued = 0;
+    tp_submit(pool, source, 1, &enqueued);
+    if (enqueued == 0) {
+        tp_graph_perform(node, pool->config.userdata);
+        tpg_settle(&node->graph->group, 1);
+    }
+}
+
+tp_error tp_graph_run(tp_threadpool *pool, tp_graph *graph) {
+    if (pool == NULL || graph == NULL) {
+        return TP_ERROR_BADARG;
+    }
+    if (!pool->is_running) {
+        return TP_ERROR_ISSHUTDOWN;
+    }
+    if (pool->is_locked) {
+        return TP_ERROR_ISLOCKED;
+    }
+    if (pool->queue.instruction) {
+        return TP_ERROR_SHUTTINGDOWN;
+    }
+    if (tpg_pending(&graph->graph.group)) {
+        return TP_ERROR_NOTCOMPLETE;
+    }
+    if (!tpn_validate(&graph->graph)) {
+        return TP_ERROR_BADARG;
+    }
+    tpn_reset(&graph->graph, pool);
+    size_t count = graph->graph.count;
+    for (size_t i = 0; i < count; i++) {
+        if (graph->graph.nodes[i].predecessors == 0) {
+            tp_graph_launch(pool, &graph->graph.nodes[i]);
+        }
+    }
+    return TP_ERROR_OK;
+}
+
+tp_error tp_graph_wait(tp_graph *graph) {
+    if (graph == NULL) {
+        return TP_ERROR_BADARG;
+    }
+    tpg_wait(&graph->graph.group);
+    return TP_ERROR_OK;
+}
+
+tp_error tp_graph_timedwait(tp_graph *graph, size_t millis) {
+    if (graph == NULL) {
+        return TP_ERROR_BADARG;
+    }
+    return tpg_timedwait(&graph->graph.group, millis) ? TP_ERROR_OK : TP_ERROR_TIMEOUT;
+}
+
+tp_error tp_graph_destroy(tp_graph *graph) {
+    if (graph == NULL) {
+        return TP_ERROR_BADARG;
+    }
+    if (tpg_pending(&graph->graph.group)) {
+        return TP_ERROR_NOTCOMPLETE;
+    }
+    tpn_destroy(&graph->graph);
+    free(graph);
+    return TP_ERROR_OK;
+}
+
+size_t tp_participants(tp_threadpool *pool, size_t chunks) {
+    size_t helpers = pool->config.min_threads + pool->config.more_threads;
+    return (chunks ? chunks - 1 < helpers ? chunks - 1 : helpers : 0) + 1;
+}
+
+tpi_error tp_distribute(tp_threadpool *pool, size_t begin, size_t end, size_t grain, size_t participants, tpp_body body, void *context) {
+    size_t helpers = participants - 1;
+    tps_cache *cache = tpw_gen_cache(&pool->gen);
+    tpp_loop *loop = tps_share(&pool->slab, cache, sizeof(tpp_loop), participants);
+    if (!loop) {
+        return TPI_ERROR_NOMEMORY;
+    }
+    tpi_error error = tpp_loop_init(loop, begin, end, grain, participants, body, context);
+    if (error) {
+        tps_unshare(&pool->slab, cache, loop, participants);
+        return error;
+    }
+    size_t enqueued = 0;
+    if (helpers) {
+        tp_source source = {
+            .model = {
+                .taskdata = loop,
+                .work = &tpp_loop_helper,
+                .storage = TPI_STORAGE_SHARED,
+                .internal = true
+            },
+            .bounded = true
+        };
+        tp_submit(pool, source, helpers, &enqueued);
+    }
+    tpp_loop_run(loop);
+    tpp_loop_wait(loop);
+    tpp_loop_destroy(loop);
+    tps_unshare(&pool->slab, cache, loop, participants - enqueued);
+    return TPI_ERROR_OK;
+}
+
+tp_error tp_parallel_check(tp_threadpool *pool) {
+    if (!pool->is_running) {
+        return TP_ERROR_ISSHUTDOWN;
+    }
+    if (pool->is_locked) {
+        return TP_ERROR_ISLOCKED;
+    }
+    if (pool->queue.instruction) {
+        return TP_ERROR_SHUTTINGDOWN;
+    }
+    return TP_ERROR_OK;
+}
+
+tp_error tp_parallel_for(tp_threadpool *pool, size_t begin, size_t end, size_t grain, tp_range body, void *context) {
+    if (pool == NULL || body == NULL) {
+        return TP_ERROR_BADARG;
+    }
+    tp_error check = tp_parallel_check(pool);
+    if (check) {
+        return check;
+    }
+    if (end <= begin) {
+        return TP_ERROR_OK;
+    }
+    grain = grain ? grain : 1;
+    tpp_range range = {
+        .body = body,
+        .context = context
+    };
+    size_t participants = tp_participants(pool, (end - begin) / grain + ((end - begin) % grain ? 1 : 0));
+    return tpfromtpi_error(tp_distribute(pool, begin, end, grain, participants, &tpp_range_body, &range));
+}
+
+tp_error tp_parallel_reduce(tp_threadpool *pool, const void *base, size_t count, size_t size, size_t grain, const void *identity, tp_combine combine, void *result, void *context) {
+    if (pool == NULL || (count && base == NULL) || size == 0 || identity == NULL || combine == NULL || result == NULL) {
+        return TP_ERROR_BADARG;
+    }
+    tp_error check = tp_parallel_check(pool);
+    if (check) {
+        return check;
+    }
+    if (count == 0) {
+        memcpy(result, identity, size);
+        return TP_ERROR_OK;
+    }
+    grain = grain ? grain : 1;
+    size_t participants = tp_participants(pool, count / grain + (count % grain ? 1 : 0));
+    size_t blocks = participants * 4;
+    size_t blocklength = count / blocks + (count % blocks ? 1 : 0);
+    if (blocklength < grain) {
+        blocklength = grain;
+    }
+    blocks = count / blocklength + (count % blocklength ? 1 : 0);
+    size_t stride = (size + TPU_CACHELINE - 1) / TPU_CACHELINE * TPU_CACHELINE;
+    unsigned char *scratch = tpu_aligned_calloc(blocks + 1, stride);
+    if (!scratch) {
+        return TP_ERROR_NOMEMORY;
+    }
+    tpp_fold fold = {
+        .input = base,
+        .count = count,
+        .size = size,
+        .stride = stride,
+        .blocklength = blocklength,
+        .blocks = scratch + stride,
+        .identity = identity,
+        .combine = combine,
+        .context = context
+    };
+    tpi_error error = tp_distribute(pool, 0, blocks, 1, participants, &tpp_scan_sum_body, &fold);
+    if (!error) {
+        memcpy(scratch, identity, size);
+        for (size_t i = 0; i < blocks; i++) {
+            combine(scratch, fold.blocks + i * stride, context);
+        }
+        memcpy(result, scratch, size);
+    }
+    free(scratch);
+    return tpfromtpi_error(error);
+}
+
+tp_error tp_parallel_scan(tp_threadpool *pool, const void *input, void *output, size_t count, size_t size, size_t grain, const void *identity, tp_combine combine, void *context) {
+    if (pool == NULL || (count && (input == NULL || output == NULL)) || size == 0 || identity == NULL || combine == NULL) {
+        return TP_ERROR_BADARG;
+    }
+    tp_error check = tp_parallel_check(pool);
+    if (check) {
+        return check;
+    }
+    if (count == 0) {
+        return TP_ERROR_OK;
+    }
+    grain = grain ? grain : 1;
+    size_t participants = tp_participants(pool, count / grain + (count % grain ? 1 : 0));
+    size_t blocks = participants * 4;
+    size_t blocklength = count / blocks + (count % blocks ? 1 : 0);
+    if (blocklength < grain) {
+        blocklength = grain;
+    }
+    blocks = count / blocklength + (count % blocklength ? 1 : 0);
+    size_t stride = (size + TPU_CACHELINE - 1) / TPU_CACHELINE * TPU_CACHELINE;
+    unsigned char *scratch = tpu_aligned_calloc(participants + blocks + 1, stride);
+    if (!scratch) {
+        return TP_ERROR_NOMEMORY;
+    }
+    tpp_fold fold = {
+        .input = input,
+        .output = output,
+        .count = count,
+        .size = size,
+        .stride = stride,
+        .blocklength = blocklength,
+        .partials = scratch,
+        .blocks = scratch + participants * stride,
+        .identity = identity,
+        .combine = combine,
+        .context = context
+    };
+    tpi_error error = tp_distribute(pool, 0, blocks, 1, participants, &tpp_scan_sum_body, &fold);
+    if (!error) {
+        unsigned char *running = fold.blocks + blocks * stride;
+        memcpy(running, identity, size);
+        for (size_t i = 0; i < blocks; i++) {
+            unsigned char *sum = fold.blocks + i * stride;
+            memcpy(scratch, sum, size);
+            memcpy(sum, running, size);
+            combine(running, scratch, context);
+        }
+        error = tp_distribute(pool, 0, blocks, 1, participants, &tpp_scan_apply_body, &fold);
+    }
+    free(scratch);
+    return tpfromtpi_error(error);
+}
+
+tp_error tp_parallel_sort(tp_threadpool *pool, void *base, size_t count, size_t size, int (* compare)(const void *, const void *)) {
+    if (pool == NULL || (count && base == NULL) || size == 0 || compare == NULL) {
+        return TP_ERROR_BADARG;
+    }
+    tp_error check = tp_parallel_check(pool);
+    if (check) {
+        return check;
+    }
+    size_t participants = tp_participants(pool, count / TPP_SORT_CUTOFF);
+    if (participants == 1) {
+        qsort(base, count, size, compare);
+        return TP_ERROR_OK;
+    }
+    tpp_sort sort = {
+        .source = base,
+        .target = malloc(count * size),
+        .count = count,
+        .size = size,
+        .run = count / participants + (count % participants ? 1 : 0),
+        .compare = compare
+    };
+    if (!sort.target) {
+        return TP_ERROR_NOMEMORY;
+    }
+    size_t runs = count / sort.run + (count % sort.run ? 1 : 0);
+    tpi_error error = tp_distribute(pool, 0, runs, 1, participants, &tpp_sort_runs_body, &sort);
+    for (; !error && sort.run < count; sort.run *= 2) {
+        size_t pairs = count / (2 * sort.run) + (count % (2 * sort.run) ? 1 : 0);
+        sort.pieces = 2 * participants / pairs + (2 * participants % pairs ? 1 : 0);
+        error = tp_distribute(pool, 0, pairs * sort.pieces, 1, participants, &tpp_sort_merge_body, &sort);
+        unsigned char *swap = sort.source;
+        sort.source = sort.target;
+        sort.target = swap;
+    }
+    if (sort.source != base) {
+        if (!error) {
+            memcpy(base, sort.source, count * size);
+        }
+        free(sort.source);
+    } else {
+        free(sort.target);
+    }
+    return tpfromtpi_error(error);
+}
+
+tp_error tp_enqueue_inline(tp_threadpool *pool, tp_task task, const void *payload, size_t length, bool *wasenqueued) {
+    if (pool == NULL || task == NULL || (length && payload == NULL)) {
+        return TP_ERROR_BADARG;
+    }
+    if (!pool->is_running) {
+        return TP_ERROR_ISSHUTDOWN;
+    }
+    if (pool->is_locked) {
+        return TP_ERROR_ISLOCKED;
+    }
+    if (pool->queue.instruction) {
+        return TP_ERROR_SHUTTINGDOWN;
+    }
+    tp_source source = {
+        .model = {
+            .work = task,
+            .storage = TPI_STORAGE_INLINE
+        }
+    };
+    tps_cache *cache = NULL;
+    if (length <= TPI_INLINE_SIZE) {
+        memcpy(source.model.payload, payload, length);
+    } else {
+        cache = tpw_gen_cache(&pool->gen);
+        if ((source.model.taskdata = tps_alloc(&pool->slab, cache, length)) == NULL) {
+            *wasenqueued = false;
+            return TP_ERROR_NOMEMORY;
+        }
+        memcpy(source.model.taskdata, payload, length);
+        source.model.storage = TPI_STORAGE_SLAB;
+    }
+    size_t enqueued = 0;
+    tpi_error error = tp_submit(pool, source, 1, &enqueued);
+    if (enqueued == 0) {
+        tps_discard(&pool->slab, cache, source.model);
+    }
+    *wasenqueued = enqueued == 1;
+    return tpfromtpi_error(error);
+}
+
+tp_error tp_enqueue_batch(tp_threadpool *pool, tp_task task, void **taskdata, size_t count, size_t *enqueued) {
+    if (pool == NULL || task == NULL || (count && taskdata == NULL)) {
+        return TP_ERROR_BADARG;
+    }
+    if (!pool->is_running) {
+        return TP_ERROR_ISSHUTDOWN;
+    }
+    if (pool->is_locked) {
+        return TP_ERROR_ISLOCKED;
+    }
+    if (pool->queue.instruction) {
+        return TP_ERROR_SHUTTINGDOWN;
+    }
+    *enqueued = 0;
+    if (count == 0) {
+        return TP_ERROR_OK;
+    }
+    tp_source source = {
+        .model = {
+            .work = task
+        },
+        .taskdata = taskdata
+    };
+    return tpfromtpi_error(tp_submit(pool, source, count, enqueued));
+}
+
+tp_error tp_enqueue_entries(tp_threadpool *pool, const tp_entry *entries, size_t count, size_t *enqueued) {
+    if (pool == NULL || (count && entries == NULL)) {
+        return TP_ERROR_BADARG;
+    }
+    if (!pool->is_running) {
+        return TP_ERROR_ISSHUTDOWN;
+    }
+    if (pool->is_locked) {
+        return TP_ERROR_ISLOCKED;
+    }
+    if (pool->queue.instruction) {
+        return TP_ERROR_SHUTTINGDOWN;
+    }
+    *enqueued = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (entries[i].task == NULL) {
+            return TP_ERROR_BADARG;
+        }
+    }
+    if (count == 0) {
+        return TP_ERROR_OK;
+    }
+    tp_source source = {
+        .entries = entries
+    };
+    return tpfromtpi_error(tp_submit(pool, source, count, enqueued));
+}
+
+tp_error tp_waitforclear(tp_threadpool *pool) {
+    if (pool == NULL) {
+        return TP_ERROR_BADARG;
+    }
+    if (!pool->is_running) {
+        return TP_ERROR_ISSHUTDOWN;
+    }
+    if (pool->is_locked) {
+        return TP_ERROR_ISLOCKED;
+    }
+    if (pool->queue.instruction) {
+        return TP_ERROR_SHUTTINGDOWN;
+    }
+    tpc_manifest_acquire(&pool->manifest);
+    tpc_manifest_waitfor(&pool->manifest, TPC_TARGET_QUEUED, TPC_EVENT_ZERO);
+    tpc_manifest_waitfor(&pool->manifest, TPC_TARGET_BUSY, TPC_EVENT_ZERO);
+    tpc_manifest_release(&pool->manifest);
+    return TP_ERROR_OK;
+}
+
+tp_error tp_timedwaitforclear(tp_threadpool *pool, size_t millis) {
+    if (pool == NULL) {
+        return TP_ERROR_BADARG;
+    }
+    if (!pool->is_running) {
+        return TP_ERROR_ISSHUTDOWN;
+    }
+    if (pool->is_locked) {
+        return TP_ERROR_ISLOCKED;
+    }
+    if (pool->queue.instruction) {
+        return TP_ERROR_SHUTTINGDOWN;
+    }
+    tpc_manifest_acquire(&pool->manifest);
+    size_t start = tpu_millitime();
+    if (!tpc_manifest_timedwaitfor(&pool->manifest, TPC_TARGET_QUEUED, TPC_EVENT_ZERO, millis)) {
+        tpc_manifest_release(&pool->manifest);
+        return TP_ERROR_TIMEOUT;
+    }
+    size_t remainder = millis - (tpu_millitime() - start);
+    if (millis < remainder) {
+        tpc_manifest_release(&pool->manifest);
+        return TP_ERROR_TIMEOUT;
+    }
+    if (!tpc_manifest_timedwaitfor(&pool->manifest, TPC_TARGET_BUSY, TPC_EVENT_ZERO, remainder)) {
+        tpc_manifest_release(&pool->manifest);
+        return TP_ERROR_TIMEOUT;
+    }
+    tpc_manifest_release(&pool->manifest);
+    return TP_ERROR_OK;
+}
+
+tp_error tp_waitforqempty(tp_threadpool *pool) {
+    if (pool == NULL) {
+        return TP_ERROR_BADARG;
+    }
+    if (!pool->is_running) {
+        return TP_ERROR_ISSHUTDOWN;
+    }
+    if (pool->is_locked) {
+        return TP_ERROR_ISLOCKED;
+    }
+    if (pool->queue.instruction) {
+        return TP_ERROR_SHUTTINGDOWN;
+    }
+    tpc_manifest_acquire(&pool->manifest);
+    tpc_manifest_waitfor(&pool->manifest, TPC_TARGET_QUEUED, TPC_EVENT_ZERO);
+    tpc_manifest_release(&pool->manifest);
+    return TP_ERROR_OK;
+}
+
+tp_error tp_timedwaitforqempty(tp_threadpool *pool, size_t millis) {
+    if (pool == NULL) {
+        return TP_ERROR_BADARG;
+    }
+    if (!pool->is_running) {
+        return TP_ERROR_ISSHUTDOWN;
+    }
+    if (pool->is_locked) {
+        return TP_ERROR_ISLOCKED;
+    }
+    if (pool->queue.instruction) {
+        return TP_ERROR_SHUTTINGDOWN;
+    }
+    tpc_manifest_acquire(&pool->manifest);
+    bool success = tpc_manifest_timedwaitfor(&pool->manifest, TPC_TARGET_QUEUED, TPC_EVENT_ZERO, millis);
+    tpc_manifest_release(&pool->manifest);
+    return success ? TP_ERROR_OK : TP_ERROR_TIMEOUT;
+}
+
+tpc_event tpcfromtp_change(tp_change change) {
+    switch (change) {
+        case TP_CHANGE_DECREMENT:
+            return TPC_EVENT_DECREMENT;
+        case TP_CHANGE_INCREMENT:
+            return TPC_EVENT_INCREMENT;
+        case TP_CHANGE_ZERO:
+            return TPC_EVENT_ZERO;
+    }
+}
+
+tpc_target tpcfromtp_component(tp_component component) {
+    switch (component) {
+        case TP_COMPONENT_BUSY:
+            return TPC_TARGET_BUSY;
+        case TP_COMPONENT_QUEUED:
+            return TPC_TARGET_QUEUED;
+        case TP_COMPONENT_WAITING:
+            return TPC_TARGET_BUSY;
+        case TP_COMPONENT_WORKERS:
+            return TPC_TARGET_WORKERS;
+    }
+}
+
+tp_error tp_waitforchange(tp_threadpool *pool, tp_component component, tp_change change) {
+    if (pool == NULL) {
+        return TP_ERROR_BADARG;
+    }
+    if (!pool->is_running) {
+        return TP_ERROR_ISSHUTDOWN;
+    }
+    if (pool->is_locked) {
+        return TP_ERROR_ISLOCKED;
+    }
+    if (pool->queue.instruction) {
+        return TP_ERROR_SHUTTINGDOWN;
+    }
+    tpc_target target = tpcfromtp_component(component);
+    tpc_event event = tpcfromtp_change(change);
+    if (component == TP_COMPONENT_WAITING) {
+        switch (change) {
+            case TP_CHANGE_DECREMENT:
+                event = TPC_EVENT_INCREMENT;
+                break;
+            case TP_CHANGE_INCREMENT:
+                event = TPC_EVENT_DECREMENT;
+                break;
+            case TP_CHANGE_ZERO:
+                return TP_ERROR_ZEROWAITING;
+        }
+    }
+    tpc_manifest_acquire(&pool->manifest);
+    tpc_manifest_waitfor(&pool->manifest, target, event);
+    tpc_manifest_release(&pool->manifest);
+    return TP_ERROR_OK;
+}
+
+tp_error tp_timedwaitforchange(tp_threadpool *pool, tp_component component, tp_change change, size_t millis) {
+    if (pool == NULL) {
+        return TP_ERROR_BADARG;
+    }
+    if (!pool->is_running) {
+        return TP_ERROR_ISSHUTDOWN;
+    }
+    if (pool->is_locked) {
+        return TP_ERROR_ISLOCKED;
+    }
+    if (pool->queue.instruction) {
+        return TP_ERROR_SHUTTINGDOWN;
+    }
+    tpc_target target = tpcfromtp_component(component);
+    tpc_event event = tpcfromtp_change(change);
+    if (component == TP_COMPONENT_WAITING) {
+        switch (change) {
+            case TP_CHANGE_DECREMENT:
+                event = TPC_EVENT_INCREMENT;
+                break;
+            case TP_CHANGE_INCREMENT:
+                event = TPC_EVENT_DECREMENT;
+                break;
+            case TP_CHANGE_ZERO:
+                return TP_ERROR_ZEROWAITING;
+        }
+    }
+    tpc_manifest_acquire(&pool->manifest);
+    bool success = tpc_manifest_timedwaitfor(&pool->manifest, target, event, millis);
+    tpc_manifest_release(&pool->manifest);
+    return success ? TP_ERROR_OK : TP_ERROR_TIMEOUT;
+}
+
+tp_error tp_lock(tp_threadpool *pool) {
+    if (pool == NULL) {
+        return TP_ERROR_BADARG;
+    }
+    if (!pool->is_running) {
+        return TP_ERROR_ISSHUTDOWN;
+    }
+    if (pool->is_locked) {
+        return TP_ERROR_ISLOCKED;
+    }
+    if (pool->queue.instruction) {
+        return TP_ERROR_SHUTTINGDOWN;
+    }
+    tpq_acquire(&pool->queue);
+    atomic_store(&pool->queue.paused, true);
+    pool->is_locked = true;
+    return TP_ERROR_OK;
+}
+
+tp_error tp_unlock(tp_threadpool *pool) {
+    if (pool == NULL) {
+        return TP_ERROR_BADARG;
+    }
+    if (!pool->is_running) {
+        return TP_ERROR_ISSHUTDOWN;
+    }
+    if (!pool->is_locked) {
+        return TP_ERROR_ISNOTLOCKED;
+    }
+    if (pool->queue.instruction) {
+        return TP_ERROR_SHUTTINGDOWN;
+    }
+    atomic_store(&pool->queue.paused, false);
+    int result = pthread_mutex_unlock(&pool->queue.mutex);
+    switch (result) {
+        case 0:
+            pool->is_locked = false;
             return TP_ERROR_OK;
         case EPERM:
+            atomic_store(&pool->queue.paused, true);
             return TP_ERROR_LOCKEDELSEWHERE;
         default:
             return TP_ERROR_UNKNOWN;
@@ -697,6 +2086,8 @@ tp_error tp_shutdown(tp_threadpool *pool) {
     if (pool->queue.instruction) {
         return TP_ERROR_SHUTTINGDOWN;
     }
+    tpz_controller_stop(&pool->sizer);
+    tpt_wheel_stop(&pool->timers);
     tpq_acquire(&pool->queue);
     tpc_manifest_acquire(&pool->manifest);
     if (pool->queue.instruction) {
@@ -707,8 +2098,10 @@ tp_error tp_shutdown(tp_threadpool *pool) {
     pool->queue.instruction = TPI_INSTR_SHUTDOWN;
     pthread_cond_broadcast(&pool->queue.cond);
     tpq_release(&pool->queue);
+    tpq_unblock(&pool->queue);
     tpc_manifest_waitfor(&pool->manifest, TPC_TARGET_WORKERS, TPC_EVENT_ZERO);
     tpc_manifest_release(&pool->manifest);
+    tpc_manifest_flush(&pool->manifest);
     pool->is_running = false;
     return TP_ERROR_OK;
 }
@@ -720,9 +2113,16 @@ tp_error tp_destroy(tp_threadpool *pool) {
     if (pool->is_running) {
         return TP_ERROR_ISRUNNING;
     }
+    tpt_wheel_destroy(&pool->timers);
+    tpw_gen_destory(&pool->gen);
+    tpi_task task;
+    while (tpq_take(&pool->queue, &task)) {
+        tpw_discard(&pool->slab, NULL, task);
+    }
+    tpf_registry_close(pool->handles);
     tpc_manifest_destroy(&pool->manifest);
     tpq_destroy(&pool->queue);
-    tpw_gen_destory(&pool->gen);
+    tps_destroy(&pool->slab);
     free(pool);
     return TP_ERROR_OK;
 }
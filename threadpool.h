@@ -10,8 +10,14 @@ extern "C" {
 
 #define TP_API_VERSION 1
 #define TP_MESSAGE_MAXSIZE 96
+#define TP_INLINE_MAXSIZE 24
 
 typedef struct tp_threadpool tp_threadpool;
+typedef struct tp_handle tp_handle;
+typedef struct tp_group tp_group;
+typedef struct tp_graph tp_graph;
+typedef struct tp_completions tp_completions;
+typedef struct tp_timer tp_timer;
 
 typedef enum {
     TP_ERROR_OK = 0,
@@ -28,6 +34,11 @@ typedef enum {
     TP_ERROR_LOCKEDELSEWHERE,
     TP_ERROR_TIMEOUT,
     TP_ERROR_ZEROWAITING,
+    TP_ERROR_NOTCOMPLETE,
+    TP_ERROR_NOTPERFORMED,
+    TP_ERROR_CANCELLED,
+    TP_ERROR_QUEUEFULL,
+    TP_ERROR_UNSUPPORTED,
     TP_ERROR_UNKNOWN
 } tp_error;
 
@@ -41,7 +52,10 @@ typedef enum {
     TP_CONFIGEVAL_NOTHREADS,
     TP_CONFIGEVAL_TOOMANYTHREADS,
     TP_CONFIGEVAL_QRESIZEZERO,
-    TP_CONFIGEVAL_PROCSCOPENSUP
+    TP_CONFIGEVAL_PROCSCOPENSUP,
+    TP_CONFIGEVAL_BADSCHEDULE,
+    TP_CONFIGEVAL_BADAFFINITY,
+    TP_CONFIGEVAL_BADSIZING
 } tp_configeval;
 
 typedef enum {
@@ -50,10 +64,34 @@ typedef enum {
     TP_CONTENTIONSCOPE_SYSTEM
 } tp_contentionscope;
 
+typedef enum {
+    TP_SIZING_DEMAND = 0,
+    TP_SIZING_HILLCLIMB,
+    TP_SIZING_LATENCY,
+    TP_SIZING_CUSTOM
+} tp_sizing;
+
+typedef enum {
+    TP_IDLE_BLOCK = 0,
+    TP_IDLE_SPIN
+} tp_idle;
+
+typedef enum {
+    TP_AFFINITY_NONE = 0,
+    TP_AFFINITY_CPUSET,
+    TP_AFFINITY_PINNED,
+    TP_AFFINITY_COMPACT,
+    TP_AFFINITY_SCATTER
+} tp_affinity;
+
 typedef enum {
     TP_SCHEDULE_DEFAULT = 0,
     TP_SCHEDULE_FIFO,
-    TP_SCHEDULE_ROUNDROBIN
+    TP_SCHEDULE_ROUNDROBIN,
+    TP_SCHEDULE_WORKSTEALING,
+    TP_SCHEDULE_LOCKFREE,
+    TP_SCHEDULE_PRIORITY,
+    TP_SCHEDULE_DEADLINE
 } tp_schedule;
 
 typedef struct {
@@ -62,9 +100,26 @@ typedef struct {
     size_t num_workers_waiting;
     size_t num_tasks_performed;
     size_t num_tasks_succeeded;
+    size_t num_tasks_expired;
+    size_t num_tasks_cancelled;
     double cpu_seconds;
+    double wall_seconds;
 } tp_stats;
 
+typedef struct {
+    size_t num_samples;
+    double p50_seconds;
+    double p90_seconds;
+    double p99_seconds;
+    double p999_seconds;
+    double max_seconds;
+} tp_latency;
+
+typedef struct {
+    tp_latency queue_wait;
+    tp_latency run_time;
+} tp_histograms;
+
 typedef enum {
     TP_COMPONENT_WORKERS,
     TP_COMPONENT_BUSY,
@@ -85,12 +140,33 @@ typedef enum {
 #define TP_DEFAULT_RESIZELIMIT 16
 #define TP_DEFAULT_RESIZEINCREMENT 16
 #define TP_DEFAULT_QUEUESIZE 64
+#define TP_DEFAULT_IDLESPINS 2048
+#define TP_DEFAULT_IDLEYIELDS 16
+#define TP_DEFAULT_KEEPALIVE 100000
+#define TP_DEFAULT_SIZINGINTERVAL 100000
+#define TP_DEFAULT_TARGETWAIT 1000
+#define TP_DEFAULT_TIMERTICK 1000
+
+typedef struct {
+    size_t num_workers;
+    size_t num_busy;
+    size_t num_queued;
+    double throughput;
+    double mean_wait_seconds;
+    double interval_seconds;
+} tp_sizing_sample;
 
 typedef struct {
     unsigned char api_version;
     size_t stacksize;
     size_t guardsize;
+    bool stack_arena;
+    bool stack_prefault;
     tp_contentionscope contentionscope;
+    tp_affinity affinity;
+    const size_t *affinity_cpus;
+    size_t num_affinity_cpus;
+    bool numa;
     tp_schedule threadschedule;
     size_t min_threads;
     size_t more_threads;
@@ -98,12 +174,40 @@ typedef struct {
     size_t initial_queue;
     unsigned char queue_resize_limit;
     unsigned char queue_resize_increment;
+    size_t priority_aging_micros;
+    size_t max_queued;
+    tp_idle idle_policy;
+    size_t idle_spins;
+    size_t idle_yields;
+    size_t idle_keepalive_micros;
+    tp_sizing sizing;
+    size_t sizing_interval_micros;
+    size_t target_wait_micros;
+    size_t (* sizing_controller)(tp_threadpool *pool, tp_sizing_sample sample);
+    size_t timer_tick_micros;
     void (* ontaskfailed)(tp_threadpool *pool, int result, void *taskdata);
     void (* onstatschanged)(tp_threadpool *pool, tp_stats stats);
+    size_t stats_interval_micros;
+    bool disable_timing;
     void *userdata;
 } tp_config;
 
+typedef struct {
+    void *taskdata;
+    int result;
+    bool performed;
+} tp_completion;
+
 typedef int (* tp_task)(void *taskdata, void *userdata);
+typedef void (* tp_expired)(void *taskdata, void *userdata);
+typedef void (* tp_range)(size_t begin, size_t end, void *context);
+typedef void (* tp_combine)(void *accumulator, const void *element, void *context);
+typedef bool (* tp_predicate)(tp_task task, void *taskdata, void *context);
+
+typedef struct {
+    tp_task task;
+    void *taskdata;
+} tp_entry;
 
 bool tp_info_procscopeissupported();
 unsigned char tp_info_hardwareconcurrency();
@@ -114,6 +218,7 @@ size_t tp_info_sysdefaultstack();
 struct rlimit tp_info_sysmaxstack();
 struct rlimit tp_info_sysmaxmem();
 struct rlimit tp_info_sysmaxthreads();
+size_t tp_info_numanodes();
 size_t tp_info_sizeofthreadpool();
 
 size_t tp_utils_roundedstack(size_t stacksize);
@@ -125,11 +230,14 @@ char * tp_utils_evalmessage(tp_configeval eval, char *buffer);
 char * tp_utils_errormessage(tp_error error, char *buffer);
 clock_t tp_utils_sectoclock(double seconds);
 bool tp_utils_statsareclear(tp_stats);
+unsigned long long tp_utils_nanotime();
 
 tp_error tp_create(tp_threadpool **pool, tp_config config);
 
 tp_config tp_getconfig(tp_threadpool *pool);
 tp_stats tp_getstats(tp_threadpool *pool);
+tp_error tp_getplacement(tp_threadpool *pool, int *cpus, size_t length, size_t *count);
+tp_error tp_gethistograms(tp_threadpool *pool, bool reset, tp_histograms *histograms);
 bool tp_canhandlesigs(tp_threadpool *pool);
 bool tp_isrunning(tp_threadpool *pool);
 bool tp_islocked(tp_threadpool *pool);
@@ -137,6 +245,50 @@ bool tp_isclear(tp_threadpool *pool);
 void * tp_userdata(tp_threadpool *pool);
 
 tp_error tp_enqueue(tp_threadpool *pool, tp_task task, void *taskdata, bool *wasenqueued);
+tp_error tp_tryenqueue(tp_threadpool *pool, tp_task task, void *taskdata, bool *wasenqueued);
+tp_error tp_timedenqueue(tp_threadpool *pool, tp_task task, void *taskdata, size_t millis, bool *wasenqueued);
+tp_error tp_enqueue_node(tp_threadpool *pool, size_t node, tp_task task, void *taskdata, bool *wasenqueued);
+tp_error tp_enqueue_priority(tp_threadpool *pool, tp_task task, void *taskdata, int priority, bool *wasenqueued);
+tp_error tp_enqueue_deadline(tp_threadpool *pool, tp_task task, void *taskdata, unsigned long long deadline_ns, tp_expired on_expired, bool *wasenqueued);
+tp_error tp_enqueue_handle(tp_threadpool *pool, tp_task task, void *taskdata, tp_handle **handle);
+tp_error tp_handle_wait(tp_handle *handle);
+tp_error tp_handle_timedwait(tp_handle *handle, size_t millis);
+tp_error tp_handle_result(tp_handle *handle, int *result);
+tp_error tp_handle_release(tp_handle *handle);
+tp_error tp_cancel(tp_threadpool *pool, tp_handle *handle, bool *wascancelled);
+/* Returns TP_ERROR_UNSUPPORTED for LOCKFREE, WORKSTEALING and NUMA pools, whose queues cannot be marked in place.
+   Cancelled tasks free their max_queued slot at once but stay in num_tasks_queued until a worker discards them. */
+tp_error tp_cancel_if(tp_threadpool *pool, tp_predicate predicate, void *context, size_t *cancelled);
+tp_error tp_enqueue_after(tp_threadpool *pool, tp_task task, void *taskdata, unsigned long long delay_ns, tp_timer **timer);
+tp_error tp_enqueue_periodic(tp_threadpool *pool, tp_task task, void *taskdata, unsigned long long period_ns, tp_timer **timer);
+tp_error tp_timer_cancel(tp_timer *timer, bool *wascancelled);
+tp_error tp_timer_release(tp_timer *timer);
+size_t tp_timers_pending(tp_threadpool *pool);
+tp_error tp_group_create(tp_threadpool *pool, tp_group **group);
+tp_error tp_enqueue_group(tp_group *group, tp_task task, void *taskdata, bool *wasenqueued);
+tp_error tp_group_wait(tp_group *group);
+tp_error tp_group_timedwait(tp_group *group, size_t millis);
+tp_error tp_group_cancel(tp_group *group);
+tp_error tp_group_destroy(tp_group *group);
+tp_error tp_completions_create(tp_completions **completions);
+int tp_completions_fd(tp_completions *completions);
+tp_error tp_enqueue_completion(tp_threadpool *pool, tp_completions *completions, tp_task task, void *taskdata, bool *wasenqueued);
+size_t tp_completions_drain(tp_completions *completions, tp_completion *results, size_t length);
+tp_error tp_completions_destroy(tp_completions *completions);
+tp_error tp_graph_create(tp_graph **graph);
+tp_error tp_graph_addnode(tp_graph *graph, tp_task task, void *taskdata, size_t *node);
+tp_error tp_graph_addedge(tp_graph *graph, size_t from, size_t to);
+tp_error tp_graph_run(tp_threadpool *pool, tp_graph *graph);
+tp_error tp_graph_wait(tp_graph *graph);
+tp_error tp_graph_timedwait(tp_graph *graph, size_t millis);
+tp_error tp_graph_destroy(tp_graph *graph);
+tp_error tp_parallel_for(tp_threadpool *pool, size_t begin, size_t end, size_t grain, tp_range body, void *context);
+tp_error tp_parallel_reduce(tp_threadpool *pool, const void *base, size_t count, size_t size, size_t grain, const void *identity, tp_combine combine, void *result, void *context);
+tp_error tp_parallel_scan(tp_threadpool *pool, const void *input, void *output, size_t count, size_t size, size_t grain, const void *identity, tp_combine combine, void *context);
+tp_error tp_parallel_sort(tp_threadpool *pool, void *base, size_t count, size_t size, int (* compare)(const void *, const void *));
+tp_error tp_enqueue_inline(tp_threadpool *pool, tp_task task, const void *payload, size_t length, bool *wasenqueued);
+tp_error tp_enqueue_batch(tp_threadpool *pool, tp_task task, void **taskdata, size_t count, size_t *enqueued);
+tp_error tp_enqueue_entries(tp_threadpool *pool, const tp_entry *entries, size_t count, size_t *enqueued);
 tp_error tp_waitforclear(tp_threadpool *pool);
 tp_error tp_timedwaitforclear(tp_threadpool *pool, size_t millis);
 tp_error tp_waitforqempty(tp_threadpool *pool);
@@ -0,0 +1,265 @@
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <string.h>
+#include <time.h>
+#include "tpdefs.h"
+#include "utilities.h"
+#include "timer.h"
+
+void tpt_link(tpt_timer **head, tpt_timer *timer) {
+    timer->next = *head;
+    if (*head) {
+        (*head)->prev = &timer->next;
+    }
+    *head = timer;
+    timer->prev = head;
+}
+
+void tpt_unlink(tpt_timer *timer) {
+    *timer->prev = timer->next;
+    if (timer->next) {
+        timer->next->prev = timer->prev;
+    }
+    timer->next = NULL;
+    timer->prev = NULL;
+}
+
+unsigned long long tpt_wheel_elapsed(tpt_wheel *wheel) {
+    return (tpu_nanotime() - wheel->origin) / wheel->tick;
+}
+
+void tpt_wheel_place(tpt_wheel *wheel, tpt_timer *timer) {
+    unsigned long long delta = timer->due - wheel->now;
+    for (size_t level = 0; level < TPT_LEVELS; level++) {
+        if (delta < 1ULL << (TPT_BITS * (level + 1))) {
+            tpt_link(&wheel->slots[level][(timer->due >> (TPT_BITS * level)) & TPT_MASK], timer);
+            return;
+        }
+    }
+    tpt_link(&wheel->overflow, timer);
+}
+
+void tpt_wheel_flush(tpt_wheel *wheel) {
+    size_t length = wheel->length;
+    size_t dispatched = wheel->dispatch(wheel->batch, length, wheel->context);
+    memmove(wheel->batch, wheel->batch + dispatched, (length - dispatched) * sizeof(tpi_task));
+    wheel->length = length - dispatched;
+}
+
+bool tpt_wheel_collect(tpt_wheel *wheel, tpi_task task) {
+    if (wheel->length == wheel->capacity) {
+        size_t capacity = wheel->capacity ? wheel->capacity * 2 : TPT_BATCH;
+        tpi_task *batch = realloc(wheel->batch, capacity * sizeof(tpi_task));
+        if (batch) {
+            wheel->batch = batch;
+            wheel->capacity = capacity;
+        } else if (wheel->length) {
+            tpt_wheel_flush(wheel);
+        }
+        if (wheel->length == wheel->capacity) {
+            return false;
+        }
+    }
+    wheel->batch[wheel->length++] = task;
+    return true;
+}
+
+void tpt_wheel_advance(tpt_wheel *wheel) {
+    wheel->now++;
+    for (size_t level = TPT_LEVELS; level > 0; level--) {
+        if (wheel->now & ((1ULL << (TPT_BITS * level)) - 1)) {
+            continue;
+        }
+        tpt_timer **head = level == TPT_LEVELS ? &wheel->overflow : &wheel->slots[level][(wheel->now >> (TPT_BITS * level)) & TPT_MASK];
+        tpt_timer *list = *head;
+        *head = NULL;
+        while (list) {
+            tpt_timer *next = list->next;
+            tpt_wheel_place(wheel, list);
+            list = next;
+        }
+    }
+    tpt_timer **head = &wheel->slots[0][wheel->now & TPT_MASK];
+    while (*head) {
+        tpt_timer *timer = *head;
+        tpt_unlink(timer);
+        if (!tpt_wheel_collect(wheel, timer->task)) {
+            timer->due = wheel->now + 1;
+            tpt_wheel_place(wheel, timer);
+        } else if (timer->period) {
+            timer->due = wheel->now + timer->period;
+            tpt_wheel_place(wheel, timer);
+        } else {
+            wheel->count--;
+            tpt_timer_release(timer);
+        }
+    }
+}
+
+void * tpt_wheel_routine(void *arg) {
+    tpt_wheel *wheel = arg;
+    pthread_mutex_lock(&wheel->mutex);
+    while (!wheel->stopping) {
+        if (!wheel->count && !wheel->length) {
+            pthread_cond_wait(&wheel->cond, &wheel->mutex);
+            continue;
+        }
+        unsigned long long target = tpt_wheel_elapsed(wheel);
+        if (target <= wheel->now) {
+            unsigned long long boundary = wheel->origin + (wheel->now + 1) * wheel->tick;
+            unsigned long long current = tpu_nanotime();
+            struct timespec until = tpu_micro_timespec(boundary > current ? (boundary - current + 999) / 1000 : 0);
+            pthread_cond_timedwait(&wheel->cond, &wheel->mutex, &until);
+            continue;
+        }
+        while (wheel->now < target) {
+            if (!wheel->count) {
+                wheel->now = target;
+                break;
+            }
+            tpt_wheel_advance(wheel);
+        }
+        if (wheel->length) {
+            pthread_mutex_unlock(&wheel->mutex);
+            tpt_wheel_flush(wheel);
+            pthread_mutex_lock(&wheel->mutex);
+        }
+    }
+    pthread_mutex_unlock(&wheel->mutex);
+    return NULL;
+}
+
+tpi_error tpt_wheel_init(tpt_wheel *wheel, unsigned long long tick, size_t (* dispatch)(tpi_task *, size_t, void *), void *context) {
+    bzero(wheel, sizeof(tpt_wheel));
+    int holder = 0;
+    if ((holder = pthread_mutex_init(&wheel->mutex, NULL))) {
+        return tpu_pthread_to_tpi(holder);
+    }
+    if ((holder = pthread_cond_init(&wheel->cond, NULL))) {
+        pthread_mutex_destroy(&wheel->mutex);
+        return tpu_pthread_to_tpi(holder);
+    }
+    wheel->origin = tpu_nanotime();
+    wheel->tick = tick ? tick : 1;
+    wheel->dispatch = dispatch;
+    wheel->context = context;
+    return TPI_ERROR_OK;
+}
+
+tpt_timer * tpt_timer_create(tpi_task task, bool retained) {
+    tpt_timer *timer = malloc(sizeof(tpt_timer));
+    if (!timer) {
+        return NULL;
+    }
+    timer->next = NULL;
+    timer->prev = NULL;
+    timer->wheel = NULL;
+    timer->task = task;
+    timer->due = 0;
+    timer->period = 0;
+    atomic_init(&timer->refs, retained ? 2 : 1);
+    return timer;
+}
+
+tpi_error tpt_wheel_insert(tpt_wheel *wheel, tpt_timer *timer, unsigned long long delay, unsigned long long period) {
+    pthread_mutex_lock(&wheel->mutex);
+    if (wheel->stopping) {
+        pthread_mutex_unlock(&wheel->mutex);
+        return TPI_ERROR_SHUTTINGDOWN;
+    }
+    if (!wheel->started) {
+        int holder = pthread_create(&wheel->thread, NULL, &tpt_wheel_routine, wheel);
+        if (holder) {
+            pthread_mutex_unlock(&wheel->mutex);
+            return tpu_pthread_to_tpi(holder);
+        }
+        wheel->started = true;
+    }
+    unsigned long long elapsed = tpt_wheel_elapsed(wheel);
+    if (!wheel->count && elapsed > wheel->now) {
+        wheel->now = elapsed;
+    }
+    timer->due = elapsed + (delay + wheel->tick - 1) / wheel->tick + 1;
+    if (timer->due <= wheel->now) {
+        timer->due = wheel->now + 1;
+    }
+    timer->period = period ? (period + wheel->tick - 1) / wheel->tick : 0;
+    timer->wheel = wheel;
+    tpt_wheel_place(wheel, timer);
+    if (wheel->count++ == 0) {
+        pthread_cond_signal(&wheel->cond);
+    }
+    pthread_mutex_unlock(&wheel->mutex);
+    return TPI_ERROR_OK;
+}
+
+bool tpt_timer_cancel(tpt_timer *timer) {
+    tpt_wheel *wheel = timer->wheel;
+    pthread_mutex_lock(&wheel->mutex);
+    bool linked = timer->prev != NULL;
+    if (linked) {
+        tpt_unlink(timer);
+        wheel->count--;
+    }
+    pthread_mutex_unlock(&wheel->mutex);
+    if (linked) {
+        tpt_timer_release(timer);
+    }
+    return linked;
+}
+
+void tpt_timer_release(tpt_timer *timer) {
+    if (atomic_fetch_sub(&timer->refs, 1) == 1) {
+        free(timer);
+    }
+}
+
+size_t tpt_wheel_pending(tpt_wheel *wheel) {
+    pthread_mutex_lock(&wheel->mutex);
+    size_t count = wheel->count;
+    pthread_mutex_unlock(&wheel->mutex);
+    return count;
+}
+
+void tpt_wheel_drain(tpt_timer **head) {
+    while (*head) {
+        tpt_timer *timer = *head;
+        tpt_unlink(timer);
+        tpt_timer_release(timer);
+    }
+}
+
+void tpt_wheel_stop(tpt_wheel *wheel) {
+    pthread_mutex_lock(&wheel->mutex);
+    if (wheel->stopping) {
+        pthread_mutex_unlock(&wheel->mutex);
+        return;
+    }
+    wheel->stopping = true;
+    pthread_cond_signal(&wheel->cond);
+    pthread_mutex_unlock(&wheel->mutex);
+    if (wheel->started) {
+        pthread_join(wheel->thread, NULL);
+        wheel->started = false;
+    }
+    pthread_mutex_lock(&wheel->mutex);
+    for (size_t level = 0; level < TPT_LEVELS; level++) {
+        for (size_t slot = 0; slot < TPT_SLOTS; slot++) {
+            tpt_wheel_drain(&wheel->slots[level][slot]);
+        }
+    }
+    tpt_wheel_drain(&wheel->overflow);
+    wheel->count = 0;
+    pthread_mutex_unlock(&wheel->mutex);
+}
+
+void tpt_wheel_destroy(tpt_wheel *wheel) {
+    tpt_wheel_stop(wheel);
+    pthread_cond_destroy(&wheel->cond);
+    pthread_mutex_destroy(&wheel->mutex);
+    free(wheel->batch);
+    wheel->batch = NULL;
+    wheel->length = wheel->capacity = 0;
+}
@@ -0,0 +1,50 @@
+#ifndef timer_h
+#define timer_h
+
+#define TPT_LEVELS 5
+#define TPT_BITS 6
+#define TPT_SLOTS (1 << TPT_BITS)
+#define TPT_MASK (TPT_SLOTS - 1)
+#define TPT_BATCH 64
+
+typedef struct tpt_wheel tpt_wheel;
+
+typedef struct tpt_timer {
+    struct tpt_timer *next;
+    struct tpt_timer **prev;
+    tpt_wheel *wheel;
+    tpi_task task;
+    unsigned long long due;
+    unsigned long long period;
+    atomic_uint refs;
+} tpt_timer;
+
+struct tpt_wheel {
+    pthread_t thread;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    bool stopping;
+    bool started;
+    unsigned long long origin;
+    unsigned long long tick;
+    unsigned long long now;
+    size_t count;
+    tpt_timer *slots[TPT_LEVELS][TPT_SLOTS];
+    tpt_timer *overflow;
+    tpi_task *batch;
+    size_t length;
+    size_t capacity;
+    size_t (* dispatch)(tpi_task *, size_t, void *);
+    void *context;
+};
+
+tpi_error tpt_wheel_init(tpt_wheel *wheel, unsigned long long tick, size_t (* dispatch)(tpi_task *, size_t, void *), void *context);
+tpt_timer * tpt_timer_create(tpi_task task, bool retained);
+tpi_error tpt_wheel_insert(tpt_wheel *wheel, tpt_timer *timer, unsigned long long delay, unsigned long long period);
+bool tpt_timer_cancel(tpt_timer *timer);
+void tpt_timer_release(tpt_timer *timer);
+size_t tpt_wheel_pending(tpt_wheel *wheel);
+void tpt_wheel_stop(tpt_wheel *wheel);
+void tpt_wheel_destroy(tpt_wheel *wheel);
+
+#endif
@@ -2,6 +2,7 @@
 #define tpdefs_h
 
 #include <limits.h>
+#include <stddef.h>
 
 typedef enum {
     TPI_CONTENTIONSCOPE_DEFAULT,
@@ -9,10 +10,29 @@ typedef enum {
     TPI_CONTENTIONSCOPE_SYSTEM
 } tpi_contentionscope;
 
+typedef enum {
+    TPI_SIZING_DEMAND,
+    TPI_SIZING_HILLCLIMB,
+    TPI_SIZING_LATENCY,
+    TPI_SIZING_CUSTOM
+} tpi_sizing;
+
+typedef enum {
+    TPI_AFFINITY_NONE,
+    TPI_AFFINITY_CPUSET,
+    TPI_AFFINITY_PINNED,
+    TPI_AFFINITY_COMPACT,
+    TPI_AFFINITY_SCATTER
+} tpi_affinity;
+
 typedef enum {
     TPI_SCHEDULE_DEFAULT,
     TPI_SCHEDULE_FIFO,
-    TPI_SCHEDULE_ROUNDROBIN
+    TPI_SCHEDULE_ROUNDROBIN,
+    TPI_SCHEDULE_WORKSTEALING,
+    TPI_SCHEDULE_LOCKFREE,
+    TPI_SCHEDULE_PRIORITY,
+    TPI_SCHEDULE_DEADLINE
 } tpi_schedule;
 
 typedef enum {
@@ -20,9 +40,37 @@ typedef enum {
     TPI_INSTR_SHUTDOWN
 } tpi_instr;
 
+#define TPI_INLINE_SIZE 24
+
+typedef enum {
+    TPI_STORAGE_NONE = 0,
+    TPI_STORAGE_INLINE,
+    TPI_STORAGE_SLAB,
+    TPI_STORAGE_SHARED
+} tpi_storage;
+
+typedef struct {
+    int priority;
+    unsigned long long deadline;
+    void (* expired)(void *taskdata, void *globaldata);
+    void (* dropped)(void *taskdata);
+    struct tpf_handle *handle;
+    struct tpg_group *group;
+    struct tpe_entry *event;
+} tpi_extra;
+
 typedef struct {
-    void *taskdata;
+    union {
+        unsigned char payload[TPI_INLINE_SIZE];
+        void *taskdata;
+    };
     int (* work)(void *taskdata, void *globaldata);
+    unsigned long long enqueued;
+    long long order;
+    tpi_extra *extra;
+    tpi_storage storage;
+    bool cancelled;
+    bool internal;
 } tpi_task;
 
 typedef struct {
@@ -31,9 +79,21 @@ typedef struct {
     size_t num_queued;
     size_t num_complete;
     size_t num_success;
+    size_t num_expired;
+    size_t num_cancelled;
     double cpu_time;
+    double wall_time;
 } tpi_stats;
 
+typedef struct {
+    size_t samples;
+    unsigned long long p50;
+    unsigned long long p90;
+    unsigned long long p99;
+    unsigned long long p999;
+    unsigned long long max;
+} tpi_latency;
+
 typedef enum {
     TPI_ERROR_OK = 0,
     TPI_ERROR_NOMEMORY,
@@ -41,6 +101,8 @@ typedef enum {
     TPI_ERROR_BADARG,
     TPI_ERROR_NOPERM,
     TPI_ERROR_TIMEOUT,
+    TPI_ERROR_QUEUEFULL,
+    TPI_ERROR_SHUTTINGDOWN,
     TPI_ERROR_UNKNOWN
 } tpi_error;
 
@@ -1,3 +1,4 @@
+#define _GNU_SOURCE
 #include <stdlib.h>
 #include <stdio.h>
 #include <stdbool.h>
@@ -5,6 +6,10 @@
 #include <errno.h>
 #include <string.h>
 #include <pthread.h>
+#include <sched.h>
+#include <limits.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
 #include <stdbool.h>
 #include <time.h>
 #include <sys/timeb.h>
@@ -14,6 +19,8 @@
 #define ONE_THOUSAND 1000
 #define ONE_MILLION 1000000
 #define ONE_BILLION 1000000000
+#define TPU_MPOL_PREFERRED 1
+#define TPU_NODEMASK_WORDS 16
 
 size_t tpu_millitime() {
     struct timeb base;
@@ -23,6 +30,33 @@ size_t tpu_millitime() {
     return millis;
 }
 
+size_t tpu_microtime() {
+    struct timespec spec;
+    clock_gettime(CLOCK_MONOTONIC, &spec);
+    return spec.tv_sec * ONE_MILLION + spec.tv_nsec / ONE_THOUSAND;
+}
+
+unsigned long long tpu_nanotime() {
+    struct timespec spec;
+    clock_gettime(CLOCK_MONOTONIC, &spec);
+    return spec.tv_sec * (unsigned long long) ONE_BILLION + spec.tv_nsec;
+}
+
+unsigned long long tpu_threadnanos() {
+    struct timespec spec;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &spec);
+    return spec.tv_sec * (unsigned long long) ONE_BILLION + spec.tv_nsec;
+}
+
+struct timespec tpu_micro_timespec(size_t micros) {
+    struct timespec spec;
+    clock_gettime(CLOCK_REALTIME, &spec);
+    long nanos = spec.tv_nsec + (micros % ONE_MILLION) * ONE_THOUSAND;
+    spec.tv_sec += micros / ONE_MILLION + nanos / ONE_BILLION;
+    spec.tv_nsec = nanos % ONE_BILLION;
+    return spec;
+}
+
 time_t prev = 0;
 
 struct timespec tpu_now_timespec() {
@@ -54,6 +88,16 @@ bool tpu_relative_wait(pthread_cond_t *cond, pthread_mutex_t *mutex, size_t mill
     return true;
 }
 
+void tpu_relax() {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+    __asm__ __volatile__("yield");
+#else
+    __asm__ __volatile__("" ::: "memory");
+#endif
+}
+
 size_t tpu_get_random() {
     time_t now = time(NULL);
     if (prev < now) {
@@ -75,15 +119,236 @@ size_t tpu_get_random_index(size_t max) {
     return tpu_get_random() % max;
 }
 
+size_t tpu_next_pow2(size_t value) {
+    size_t result = 1;
+    while (result < value) {
+        result <<= 1;
+    }
+    return result;
+}
+
+size_t tpu_xorshift(size_t *state) {
+    size_t x = *state ? *state : (size_t) 0x9E3779B97F4A7C15ULL;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    * state = x;
+    return x;
+}
+
+void * tpu_aligned_calloc(size_t count, size_t size) {
+    void *memory = NULL;
+    if (posix_memalign(&memory, TPU_CACHELINE, count * size)) {
+        return NULL;
+    }
+    memset(memory, 0, count * size);
+    return memory;
+}
+
+typedef struct {
+    size_t cpu;
+    long package;
+    long core;
+    size_t rank;
+} tpu_cpu;
+
+bool tpu_cpus_usable(const size_t *cpus, size_t count) {
+    cpu_set_t allowed;
+    if (sched_getaffinity(0, sizeof(cpu_set_t), &allowed)) {
+        return false;
+    }
+    for (size_t i = 0; i < count; i++) {
+        if (cpus[i] >= CPU_SETSIZE || !CPU_ISSET(cpus[i], &allowed)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+long tpu_cpu_attribute(size_t cpu, const char *name, long fallback) {
+    char path[96];
+    snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%zu/topology/%s", cpu, name);
+    FILE *file = fopen(path, "r");
+    if (!file) {
+        return fallback;
+    }
+    long value;
+    if (fscanf(file, "%ld", &value) != 1) {
+        value = fallback;
+    }
+    fclose(file);
+    return value;
+}
+
+int tpu_compact_compare(const void *a, const void *b) {
+    const tpu_cpu *x = a, *y = b;
+    if (x->package != y->package) {
+        return x->package < y->package ? -1 : 1;
+    }
+    if (x->core != y->core) {
+        return x->core < y->core ? -1 : 1;
+    }
+    return x->cpu < y->cpu ? -1 : x->cpu > y->cpu;
+}
+
+int tpu_scatter_compare(const void *a, const void *b) {
+    const tpu_cpu *x = a, *y = b;
+    if (x->rank != y->rank) {
+        return x->rank < y->rank ? -1 : 1;
+    }
+    if (x->core != y->core) {
+        return x->core < y->core ? -1 : 1;
+    }
+    if (x->package != y->package) {
+        return x->package < y->package ? -1 : 1;
+    }
+    return x->cpu < y->cpu ? -1 : x->cpu > y->cpu;
+}
+
+size_t * tpu_cpu_placement(const size_t *cpus, size_t count, tpi_affinity affinity, size_t *length) {
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    if (count) {
+        for (size_t i = 0; i < count; i++) {
+            CPU_SET(cpus[i], &allowed);
+        }
+    } else if (sched_getaffinity(0, sizeof(cpu_set_t), &allowed)) {
+        return NULL;
+    }
+    size_t total = CPU_COUNT(&allowed);
+    tpu_cpu *topology = malloc(total * sizeof(tpu_cpu));
+    size_t *placement = malloc(total * sizeof(size_t));
+    if (!topology || !placement) {
+        free(topology);
+        free(placement);
+        return NULL;
+    }
+    size_t found = 0;
+    for (size_t cpu = 0; cpu < CPU_SETSIZE && found < total; cpu++) {
+        if (CPU_ISSET(cpu, &allowed)) {
+            tpu_cpu *entry = &topology[found++];
+            entry->cpu = cpu;
+            entry->package = tpu_cpu_attribute(cpu, "physical_package_id", 0);
+            entry->core = tpu_cpu_attribute(cpu, "core_id", (long) cpu);
+            entry->rank = 0;
+            for (size_t j = 0; j + 1 < found; j++) {
+                if (topology[j].package == entry->package && topology[j].core == entry->core) {
+                    entry->rank++;
+                }
+            }
+        }
+    }
+    if (affinity == TPI_AFFINITY_COMPACT) {
+        qsort(topology, total, sizeof(tpu_cpu), &tpu_compact_compare);
+    } else if (affinity == TPI_AFFINITY_SCATTER) {
+        qsort(topology, total, sizeof(tpu_cpu), &tpu_scatter_compare);
+    }
+    for (size_t i = 0; i < total; i++) {
+        placement[i] = topology[i].cpu;
+    }
+    free(topology);
+    *length = total;
+    return placement;
+}
+
+bool tpu_read_list(const char *path, cpu_set_t *set) {
+    FILE *file = fopen(path, "r");
+    if (!file) {
+        return false;
+    }
+    CPU_ZERO(set);
+    long first, last;
+    int separator;
+    while (fscanf(file, "%ld", &first) == 1) {
+        last = first;
+        if ((separator = fgetc(file)) == '-') {
+            if (fscanf(file, "%ld", &last) != 1) {
+                break;
+            }
+            separator = fgetc(file);
+        }
+        for (long i = first; i <= last && i < CPU_SETSIZE; i++) {
+            CPU_SET(i, set);
+        }
+        if (separator != ',') {
+            break;
+        }
+    }
+    fclose(file);
+    return true;
+}
+
+size_t * tpu_cpuset_list(cpu_set_t *set, size_t *count) {
+    size_t total = CPU_COUNT(set);
+    size_t *list = malloc((total ? total : 1) * sizeof(size_t));
+    if (!list) {
+        return NULL;
+    }
+    size_t found = 0;
+    for (size_t i = 0; i < CPU_SETSIZE && found < total; i++) {
+        if (CPU_ISSET(i, set)) {
+            list[found++] = i;
+        }
+    }
+    *count = total;
+    return list;
+}
+
+size_t * tpu_numa_nodes(size_t *count) {
+    cpu_set_t nodes;
+    if (!tpu_read_list("/sys/devices/system/node/online", &nodes)) {
+        CPU_ZERO(&nodes);
+        CPU_SET(0, &nodes);
+    }
+    return tpu_cpuset_list(&nodes, count);
+}
+
+size_t * tpu_numa_cpus(size_t node, size_t *count) {
+    char path[64];
+    cpu_set_t allowed, cpus;
+    if (sched_getaffinity(0, sizeof(cpu_set_t), &allowed)) {
+        return NULL;
+    }
+    snprintf(path, sizeof(path), "/sys/devices/system/node/node%zu/cpulist", node);
+    if (tpu_read_list(path, &cpus)) {
+        CPU_AND(&allowed, &allowed, &cpus);
+    } else if (node) {
+        CPU_ZERO(&allowed);
+    }
+    return tpu_cpuset_list(&allowed, count);
+}
+
+void * tpu_numa_alloc(size_t size, size_t node) {
+    void *data = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (data == MAP_FAILED) {
+        return NULL;
+    }
+    unsigned long mask[TPU_NODEMASK_WORDS] = {0};
+    size_t bits = sizeof(unsigned long) * CHAR_BIT;
+    if (node < TPU_NODEMASK_WORDS * bits - 1) {
+        mask[node / bits] = 1UL << (node % bits);
+        syscall(SYS_mbind, data, size, TPU_MPOL_PREFERRED, mask, TPU_NODEMASK_WORDS * bits, 0);
+    }
+    return data;
+}
+
+void tpu_numa_free(void *data, size_t size) {
+    munmap(data, size);
+}
+
 tpi_error tpu_attr_init(pthread_attr_t *attr, size_t stack, size_t guard, tpi_schedule sched, tpi_contentionscope scope) {
     int result = pthread_attr_init(attr);
-    if (!result) {
+    if (result) {
         return tpu_pthread_to_tpi(result);
     }
     pthread_attr_setguardsize(attr, guard);
     pthread_attr_setstacksize(attr, stack);
     switch (sched) {
         case TPI_SCHEDULE_DEFAULT:
+        case TPI_SCHEDULE_WORKSTEALING:
+        case TPI_SCHEDULE_LOCKFREE:
+        case TPI_SCHEDULE_PRIORITY:
+        case TPI_SCHEDULE_DEADLINE:
             break;
         case TPI_SCHEDULE_FIFO:
             pthread_attr_setschedpolicy(attr, SCHED_FIFO);
@@ -109,9 +374,9 @@ bool tpu_stats_equal(tpi_stats a, tpi_stats b) {
     if (a.num_busy == b.num_busy) {
         if (a.num_complete == b.num_complete) {
             if (a.num_queued == b.num_queued) {
-                if (a.num_success == b.num_success) {
+                if (a.num_success == b.num_success && a.num_expired == b.num_expired && a.num_cancelled == b.num_cancelled) {
                     if (a.num_workers == b.num_workers) {
-                        if (a.cpu_time == b.cpu_time) {
+                        if (a.cpu_time == b.cpu_time && a.wall_time == b.wall_time) {
                             return true;
                         }
                     }
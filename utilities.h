@@ -6,11 +6,26 @@ extern "C" {
 #endif
 
 #define TPU_TIMESTAMP_LENGTH 30
+#define TPU_CACHELINE 64
 
 size_t tpu_millitime();
+size_t tpu_microtime();
+unsigned long long tpu_nanotime();
+unsigned long long tpu_threadnanos();
+struct timespec tpu_micro_timespec(size_t micros);
 bool tpu_relative_wait(pthread_cond_t *cond, pthread_mutex_t *mutex, size_t millis);
+void tpu_relax();
 size_t tpu_get_random();
 size_t tpu_get_random_index(size_t max);
+size_t tpu_next_pow2(size_t value);
+size_t tpu_xorshift(size_t *state);
+void * tpu_aligned_calloc(size_t count, size_t size);
+bool tpu_cpus_usable(const size_t *cpus, size_t count);
+size_t * tpu_cpu_placement(const size_t *cpus, size_t count, tpi_affinity affinity, size_t *length);
+size_t * tpu_numa_nodes(size_t *count);
+size_t * tpu_numa_cpus(size_t node, size_t *count);
+void * tpu_numa_alloc(size_t size, size_t node);
+void tpu_numa_free(void *data, size_t size);
 tpi_error tpu_attr_init(pthread_attr_t *attr, size_t stack, size_t guard, tpi_schedule sched, tpi_contentionscope scope);
 tpi_error tpu_pthread_to_tpi(int pterr);
 bool tpu_stats_equal(tpi_stats a, tpi_stats b);
@@ -1,115 +1,580 @@
+#define _GNU_SOURCE
 #include <stdlib.h>
+#include <stdint.h>
 #include <stdbool.h>
+#include <stdatomic.h>
 #include <pthread.h>
+#include <sched.h>
 #include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
 #include "tpdefs.h"
 #include "utilities.h"
+#include "histogram.h"
 #include "counting.h"
 #include "queue.h"
+#include "deque.h"
+#include "slab.h"
+#include "handle.h"
+#include "group.h"
+#include "event.h"
 #include "worker.h"
 
+_Thread_local tpw_worker *tpw_self = NULL;
+
+void tpw_discard(tps_slab *slab, tps_cache *cache, tpi_task task) {
+    if (task.extra && task.extra->dropped) {
+        task.extra->dropped(task.storage == TPI_STORAGE_INLINE ? task.payload : task.taskdata);
+    }
+    tpf_abandon(task);
+    tpe_abandon(task);
+    if (task.extra && task.extra->group) {
+        tpg_settle(task.extra->group, 1);
+    }
+    tps_discard(slab, cache, task);
+}
+
+void tpw_worker_perform(tpw_worker *self, tpi_task task) {
+    void *taskdata = task.storage == TPI_STORAGE_INLINE ? task.payload : task.taskdata;
+    tpi_extra *extra = task.extra;
+    if (task.cancelled || (extra && ((extra->handle && !tpf_claim(extra->handle)) || (extra->group && tpg_iscancelled(extra->group))))) {
+        tpc_manifest_cancel(self->queue->manifest, self->shard);
+        tpw_discard(self->gen->slab, &self->slot->cache, task);
+        return;
+    }
+    if (extra && extra->deadline && extra->deadline < tpu_nanotime()) {
+        if (extra->expired) {
+            extra->expired(taskdata, self->userdata);
+        }
+        tpc_manifest_expire(self->queue->manifest, self->shard);
+        tpw_discard(self->gen->slab, &self->slot->cache, task);
+        return;
+    }
+    unsigned long long began = 0, ended = 0, cpu = 0;
+    if (self->timed) {
+        began = tpu_nanotime();
+        cpu = tpu_threadnanos();
+    }
+    int result = task.work(taskdata, self->userdata);
+    if (self->timed) {
+        cpu = tpu_threadnanos() - cpu;
+        ended = tpu_nanotime();
+        tpc_manifest_record(self->queue->manifest, self->shard, began > task.enqueued ? began - task.enqueued : 0, ended - began);
+    }
+    if (result && !task.internal && self->ontaskfailed) {
+        self->ontaskfailed(result, taskdata, self->g_data);
+    }
+    tpc_manifest_finish(self->queue->manifest, self->shard, result, cpu, ended - began);
+    if (extra && extra->handle) {
+        tpf_complete(extra->handle, TPF_STATE_DONE, result);
+    }
+    if (extra && extra->event) {
+        tpe_post(extra->event, true, result);
+    }
+    if (extra && extra->group) {
+        tpg_settle(extra->group, 1);
+    }
+    tps_discard(self->gen->slab, &self->slot->cache, task);
+}
+
+void tpw_worker_claim(tpw_worker *self, tpi_task *task) {
+    tpc_manifest_begin(self->queue->manifest, self->shard);
+    tpc_manifest_quickdecrement(self->queue->manifest, TPC_TARGET_QUEUED);
+    if (!task->cancelled) {
+        tpq_vacate(self->queue, 1);
+    }
+}
+
+bool tpw_worker_steal(tpw_worker *self, tpi_task *task) {
+    tpw_gen *gen = self->gen;
+    size_t start = tpu_xorshift(&self->seed) % gen->maxthreads;
+    for (size_t i = 0; i < gen->maxthreads; i++) {
+        tpw_slot *victim = &gen->slots[(start + i) % gen->maxthreads];
+        if (victim == self->slot || !atomic_load_explicit(&victim->occupied, memory_order_acquire)) {
+            continue;
+        }
+        if (tpd_steal(&victim->deque, task)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool tpw_worker_local(tpw_worker *self, tpi_task *task) {
+    tpw_gen *gen = self->gen;
+    return gen->num_nodes && tpq_ring_pop(&gen->nodes[self->slot->node].ring, task);
+}
+
+bool tpw_worker_remote(tpw_worker *self, tpi_task *task) {
+    tpw_gen *gen = self->gen;
+    for (size_t i = 1; i < gen->num_nodes; i++) {
+        if (tpq_ring_pop(&gen->nodes[(self->slot->node + i) % gen->num_nodes].ring, task)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool tpw_worker_take(tpw_worker *self, tpi_task *task) {
+    if (self->queue->instruction || atomic_load_explicit(&self->queue->paused, memory_order_relaxed)) {
+        return false;
+    }
+    if (self->gen->stealing) {
+        if (!tpd_pop(&self->slot->deque, task) && !tpw_worker_local(self, task) && !tpw_worker_steal(self, task) && !tpw_worker_remote(self, task)) {
+            return false;
+        }
+    } else if (!tpw_worker_local(self, task) && !tpq_pop(self->queue, task) && !tpw_worker_remote(self, task)) {
+        return false;
+    }
+    tpw_worker_claim(self, task);
+    return true;
+}
+
+void tpw_worker_place(tpw_worker *self) {
+    tpw_gen *gen = self->gen;
+    if (gen->affinity == TPI_AFFINITY_NONE && !gen->num_nodes) {
+        return;
+    }
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (self->slot->cpu < 0 && gen->num_nodes) {
+        tpw_node *node = &gen->nodes[self->slot->node];
+        for (size_t i = 0; i < node->num_cpus; i++) {
+            CPU_SET(node->cpus[i], &set);
+        }
+    } else if (self->slot->cpu < 0) {
+        for (size_t i = 0; i < gen->num_cpus; i++) {
+            CPU_SET(gen->cpus[i], &set);
+        }
+    } else {
+        CPU_SET(self->slot->cpu, &set);
+    }
+    pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &set);
+}
+
+void tpw_worker_prefault(tpw_worker *self) {
+    tpw_gen *gen = self->gen;
+    if (!gen->prefault) {
+        return;
+    }
+    unsigned char *stack = gen->arena + (self - gen->workers) * gen->stride + gen->guard;
+#ifdef MADV_POPULATE_WRITE
+    madvise(stack, gen->stride - gen->guard, MADV_POPULATE_WRITE);
+#endif
+}
+
+bool tpw_worker_spin(tpw_worker *self, tpi_task *task) {
+    tpw_gen *gen = self->gen;
+    tpc_manifest *manifest = self->queue->manifest;
+    for (size_t i = 0; i < gen->spins + gen->yields; i++) {
+        if (i < gen->spins) {
+            tpu_relax();
+        } else {
+            sched_yield();
+        }
+        if (!tpc_manifest_count(manifest, TPC_TARGET_QUEUED)) {
+            continue;
+        }
+        if (tpw_worker_take(self, task)) {
+            return true;
+        }
+        if (tpq_trytake(self->queue, task)) {
+            tpw_worker_claim(self, task);
+            return true;
+        }
+    }
+    return false;
+}
+
+bool tpw_worker_lingered(tpw_worker *self, size_t since) {
+    return since && tpu_microtime() - since >= self->gen->keepalive;
+}
+
+void tpw_worker_linger(tpw_worker *self, size_t *since) {
+    tpw_gen *gen = self->gen;
+    if (gen->keepalive && tpc_manifest_count(self->queue->manifest, TPC_TARGET_WORKERS) > atomic_load(&gen->floor)) {
+        size_t now = tpu_microtime();
+        if (!*since) {
+            *since = now;
+        }
+        if (now - *since < gen->keepalive) {
+            tpq_timedwait(self->queue, *since + gen->keepalive - now);
+        }
+        return;
+    }
+    *since = 0;
+    tpq_wait(self->queue);
+}
+
 void * worker_routine(void *data) {
     tpw_worker *self = data;
+    tpw_gen *gen = self->gen;
+    tpc_manifest *manifest = self->queue->manifest;
+    bool retired = false;
+    size_t since = 0;
     tpi_task next;
-    tpc_manifest_acquire(self->queue->manifest);
-    tpc_manifest_increment(self->queue->manifest, TPC_TARGET_WORKERS);
-    tpc_manifest_release(self->queue->manifest);
+    tpw_self = self;
+    tpw_worker_place(self);
+    tpw_worker_prefault(self);
+    tpc_manifest_quickincrement(manifest, TPC_TARGET_WORKERS);
     while (true) {
+        if (tpw_worker_take(self, &next) || tpw_worker_spin(self, &next)) {
+            since = 0;
+            tpw_worker_perform(self, next);
+            continue;
+        }
         tpq_acquire(self->queue);
         if (self->queue->instruction) {
             tpq_release(self->queue);
             break;
         }
-        tpc_manifest_acquire(self->queue->manifest);
-        if (tpq_extract(self->queue, &next)) {
+        if (tpq_take(self->queue, &next)) {
             tpq_release(self->queue);
-            tpc_manifest_increment(self->queue->manifest, TPC_TARGET_BUSY);
-            tpc_manifest_release(self->queue->manifest);
-            clock_t start = clock();
-            int result = next.work(next.taskdata, self->userdata);
-            clock_t end = clock();
-            if (result && self->ontaskfailed) {
-                self->ontaskfailed(result, next.taskdata, self->g_data);
-            }
-            tpc_manifest_acquire(self->queue->manifest);
-            tpc_manifest_tallyresult(self->queue->manifest, result, end - start);
-            tpc_manifest_decrement(self->queue->manifest, TPC_TARGET_BUSY);
-            tpc_manifest_release(self->queue->manifest);
-        } else {
-            if (self->minthreads < self->queue->manifest->num_workers.count) {
-                tpq_release(self->queue);
-                tpc_manifest_release(self->queue->manifest);
-                break;
-            }
-            tpc_manifest_release(self->queue->manifest);
-            tpq_wait(self->queue);
-            if (self->queue->instruction) {
-                tpq_release(self->queue);
-                break;
-            }
-            tpc_manifest_acquire(self->queue->manifest);
-            if (tpq_extract(self->queue, &next)) {
-                tpq_release(self->queue);
-                tpc_manifest_increment(self->queue->manifest, TPC_TARGET_BUSY);
-                tpc_manifest_release(self->queue->manifest);
-                clock_t start = clock();
-                int result = next.work(next.taskdata, self->userdata);
-                clock_t end = clock();
-                if (result && self->ontaskfailed) {
-                    self->ontaskfailed(result, next.taskdata, self->g_data);
-                }
-                tpc_manifest_acquire(self->queue->manifest);
-                tpc_manifest_tallyresult(self->queue->manifest, result, end - start);
-                tpc_manifest_decrement(self->queue->manifest, TPC_TARGET_BUSY);
-                tpc_manifest_release(self->queue->manifest);
-            } else {
-                tpq_release(self->queue);
-                tpc_manifest_release(self->queue->manifest);
-            }
+            tpw_worker_claim(self, &next);
+            since = 0;
+            tpw_worker_perform(self, next);
+            continue;
+        }
+        atomic_fetch_add(&self->queue->sleeping, 1);
+        atomic_thread_fence(memory_order_seq_cst);
+        if (tpw_worker_take(self, &next)) {
+            atomic_fetch_sub(&self->queue->sleeping, 1);
+            tpq_release(self->queue);
+            since = 0;
+            tpw_worker_perform(self, next);
+            continue;
+        }
+        if ((!gen->keepalive || tpw_worker_lingered(self, since)) && (retired = tpc_manifest_retire(manifest, atomic_load(&gen->floor)))) {
+            atomic_fetch_sub(&self->queue->sleeping, 1);
+            tpq_release(self->queue);
+            break;
         }
+        tpw_worker_linger(self, &since);
+        atomic_fetch_sub(&self->queue->sleeping, 1);
+        tpq_release(self->queue);
     }
-    tpc_manifest *manifest = self->queue->manifest;
-    free(self);
-    tpc_manifest_acquire(manifest);
-    tpc_manifest_decrement(manifest, TPC_TARGET_WORKERS);
-    tpc_manifest_release(manifest);
+    atomic_store_explicit(&self->slot->occupied, false, memory_order_release);
+    if (!gen->arena) {
+        free(self);
+    }
+    if (!retired) {
+        tpc_manifest_quickdecrement(manifest, TPC_TARGET_WORKERS);
+    }
+    atomic_fetch_sub_explicit(&gen->live, 1, memory_order_release);
     pthread_exit(NULL);
 }
 
+void tpw_gen_unnuma(tpw_gen *gen) {
+    for (size_t i = 0; i < gen->num_nodes; i++) {
+        free(gen->nodes[i].cpus);
+        if (gen->nodes[i].ring.cells) {
+            tpu_numa_free(gen->nodes[i].ring.cells, gen->nodes[i].length * sizeof(tpq_cell));
+        }
+    }
+    free(gen->nodes);
+    free(gen->cpunode);
+    gen->nodes = NULL;
+    gen->cpunode = NULL;
+    gen->num_nodes = gen->num_cpunode = 0;
+}
+
+tpi_error tpw_gen_numa(tpw_gen *gen, size_t nodesize) {
+    size_t count = 0;
+    size_t *ids = tpu_numa_nodes(&count);
+    if (!ids || (gen->nodes = tpu_aligned_calloc(count, sizeof(tpw_node))) == NULL) {
+        free(ids);
+        return TPI_ERROR_NOMEMORY;
+    }
+    size_t length = tpu_next_pow2(nodesize < 2 ? 2 : nodesize);
+    for (size_t i = 0; i < count; i++) {
+        tpw_node *node = &gen->nodes[gen->num_nodes];
+        if ((node->cpus = tpu_numa_cpus(ids[i], &node->num_cpus)) == NULL) {
+            free(ids);
+            tpw_gen_unnuma(gen);
+            return TPI_ERROR_NOMEMORY;
+        }
+        if (!node->num_cpus) {
+            free(node->cpus);
+            node->cpus = NULL;
+            continue;
+        }
+        gen->num_nodes++;
+        tpq_cell *cells = tpu_numa_alloc(length * sizeof(tpq_cell), ids[i]);
+        if (!cells) {
+            free(ids);
+            tpw_gen_unnuma(gen);
+            return TPI_ERROR_NOMEMORY;
+        }
+        node->id = ids[i];
+        node->length = length;
+        tpq_ring_init(&node->ring, cells, length);
+        for (size_t j = 0; j < node->num_cpus; j++) {
+            if (node->cpus[j] >= gen->num_cpunode) {
+                gen->num_cpunode = node->cpus[j] + 1;
+            }
+        }
+    }
+    free(ids);
+    if (!gen->num_nodes || (gen->cpunode = calloc(gen->num_cpunode, sizeof(size_t))) == NULL) {
+        tpw_gen_unnuma(gen);
+        return gen->num_nodes ? TPI_ERROR_NOMEMORY : TPI_ERROR_OK;
+    }
+    for (size_t i = 0; i < gen->num_nodes; i++) {
+        for (size_t j = 0; j < gen->nodes[i].num_cpus; j++) {
+            gen->cpunode[gen->nodes[i].cpus[j]] = i;
+        }
+    }
+    return TPI_ERROR_OK;
+}
+
+void tpw_gen_unarena(tpw_gen *gen) {
+    if (gen->arena) {
+        munmap(gen->arena, gen->arenasize);
+    }
+    free(gen->workers);
+    gen->arena = NULL;
+    gen->workers = NULL;
+}
+
+tpi_error tpw_gen_arena(tpw_gen *gen, tpw_gen_config config) {
+    size_t page = getpagesize();
+    gen->guard = (config.guardsize + page - 1) / page * page;
+    gen->stride = gen->guard + config.stacksize;
+    gen->arenasize = gen->stride * config.maxthreads;
+    gen->prefault = config.prefault && config.numa;
+    int flags = MAP_PRIVATE | MAP_ANONYMOUS | MAP_STACK | (config.prefault && !config.numa ? MAP_POPULATE : MAP_NORESERVE);
+    void *arena = mmap(NULL, gen->arenasize, PROT_READ | PROT_WRITE, flags, -1, 0);
+    if (arena == MAP_FAILED) {
+        return TPI_ERROR_NOMEMORY;
+    }
+    gen->arena = arena;
+    for (size_t i = 0; i < config.maxthreads && gen->guard; i++) {
+        mprotect(gen->arena + i * gen->stride, gen->guard, PROT_NONE);
+    }
+    if ((gen->workers = calloc(config.maxthreads, sizeof(tpw_worker))) == NULL) {
+        tpw_gen_unarena(gen);
+        return TPI_ERROR_NOMEMORY;
+    }
+    pthread_attr_setdetachstate(&gen->attr, PTHREAD_CREATE_JOINABLE);
+    return TPI_ERROR_OK;
+}
+
 tpi_error tpw_gen_init(tpw_gen *gen, tpw_gen_config config) {
     bzero(gen, sizeof(tpw_gen));
     tpi_error result = tpu_attr_init(&gen->attr, config.stacksize, config.guardsize, config.schedule, config.scope);
     if (result) {
         return result;
     }
+    pthread_attr_setdetachstate(&gen->attr, PTHREAD_CREATE_DETACHED);
+    if (config.arena && (result = tpw_gen_arena(gen, config))) {
+        pthread_attr_destroy(&gen->attr);
+        return result;
+    }
+    if (config.affinity != TPI_AFFINITY_NONE) {
+        if ((gen->cpus = tpu_cpu_placement(config.cpus, config.num_cpus, config.affinity, &gen->num_cpus)) == NULL) {
+            tpw_gen_unarena(gen);
+            pthread_attr_destroy(&gen->attr);
+            return TPI_ERROR_NOMEMORY;
+        }
+    }
+    if (config.numa && (result = tpw_gen_numa(gen, config.nodesize))) {
+        free(gen->cpus);
+        tpw_gen_unarena(gen);
+        pthread_attr_destroy(&gen->attr);
+        return result;
+    }
+    if ((gen->slots = tpu_aligned_calloc(config.maxthreads, sizeof(tpw_slot))) == NULL) {
+        tpw_gen_unnuma(gen);
+        free(gen->cpus);
+        tpw_gen_unarena(gen);
+        pthread_attr_destroy(&gen->attr);
+        return TPI_ERROR_NOMEMORY;
+    }
+    atomic_init(&gen->live, 0);
+    bool pinned = config.affinity != TPI_AFFINITY_NONE && config.affinity != TPI_AFFINITY_CPUSET;
+    for (size_t i = 0; i < config.maxthreads; i++) {
+        atomic_init(&gen->slots[i].occupied, false);
+        if (gen->num_nodes) {
+            tpw_node *node = &gen->nodes[i % gen->num_nodes];
+            gen->slots[i].node = i % gen->num_nodes;
+            gen->slots[i].cpu = pinned ? (int) node->cpus[(i / gen->num_nodes) % node->num_cpus] : -1;
+        } else {
+            gen->slots[i].cpu = pinned ? (int) gen->cpus[i % gen->num_cpus] : -1;
+        }
+        if (config.stealing && (result = tpd_init(&gen->slots[i].deque, TPD_INITIAL_LENGTH))) {
+            while (i--) {
+                tpd_destroy(&gen->slots[i].deque);
+            }
+            free(gen->slots);
+            tpw_gen_unnuma(gen);
+            free(gen->cpus);
+            tpw_gen_unarena(gen);
+            pthread_attr_destroy(&gen->attr);
+            return result;
+        }
+    }
     gen->queue = config.queue;
+    gen->slab = config.slab;
     gen->minthreads = config.minthreads;
+    atomic_init(&gen->floor, config.minthreads);
+    gen->keepalive = config.keepalive;
+    gen->maxthreads = config.maxthreads;
+    gen->spins = config.spins;
+    gen->yields = config.yields;
+    gen->affinity = config.affinity;
+    gen->stealing = config.stealing;
+    gen->timed = config.timed;
     gen->ontaskfailed = config.ontaskfailed;
     gen->g_data = config.g_data;
     gen->userdata = config.userdata;
     return TPI_ERROR_OK;
 }
 
+tpw_slot * tpw_gen_claim(tpw_gen *gen) {
+    for (size_t i = 0; i < gen->maxthreads; i++) {
+        bool expected = false;
+        if (atomic_compare_exchange_strong(&gen->slots[i].occupied, &expected, true)) {
+            return &gen->slots[i];
+        }
+    }
+    return NULL;
+}
+
 tpi_error tpw_gen_generate(tpw_gen *gen) {
-    tpw_worker *worker = malloc(sizeof(tpw_worker));
+    tpw_slot *slot = tpw_gen_claim(gen);
+    if (!slot) {
+        return TPI_ERROR_OK;
+    }
+    size_t index = slot - gen->slots;
+    if (slot->joinable) {
+        pthread_join(slot->thread, NULL);
+        slot->joinable = false;
+    }
+    tpw_worker *worker = gen->arena ? &gen->workers[index] : malloc(sizeof(tpw_worker));
     if (!worker) {
+        atomic_store(&slot->occupied, false);
         return TPI_ERROR_NOMEMORY;
     }
+    if (gen->arena) {
+        pthread_attr_setstack(&gen->attr, gen->arena + index * gen->stride + gen->guard, gen->stride - gen->guard);
+    }
     bzero(worker, sizeof(tpw_worker));
+    worker->gen = gen;
+    worker->slot = slot;
+    worker->shard = tpc_manifest_shard(gen->queue->manifest, index);
     worker->queue = gen->queue;
-    worker->minthreads = gen->minthreads;
+    worker->seed = tpu_get_random();
+    worker->timed = gen->timed;
     worker->ontaskfailed = gen->ontaskfailed;
     worker->g_data = gen->g_data;
     worker->userdata = gen->userdata;
+    atomic_fetch_add(&gen->live, 1);
     int result = pthread_create(&worker->thread, &gen->attr, &worker_routine, worker);
-    if (!result) {
-        free(worker);
+    if (result) {
+        atomic_fetch_sub(&gen->live, 1);
+        atomic_store(&slot->occupied, false);
+        if (!gen->arena) {
+            free(worker);
+        }
         return tpu_pthread_to_tpi(result);
     }
+    if (gen->arena) {
+        slot->thread = worker->thread;
+        slot->joinable = true;
+    }
     return TPI_ERROR_OK;
 }
 
+tpw_worker * tpw_gen_current(tpw_gen *gen) {
+    if (gen->stealing && tpw_self && tpw_self->gen == gen) {
+        return tpw_self;
+    }
+    return NULL;
+}
+
+bool tpw_gen_ismember(tpw_gen *gen) {
+    return tpw_self && tpw_self->gen == gen;
+}
+
+tps_cache * tpw_gen_cache(tpw_gen *gen) {
+    if (tpw_self && tpw_self->gen == gen) {
+        return &tpw_self->slot->cache;
+    }
+    return NULL;
+}
+
+size_t tpw_gen_setfloor(tpw_gen *gen, size_t floor) {
+    return atomic_exchange(&gen->floor, floor > gen->minthreads ? floor : gen->minthreads);
+}
+
+size_t tpw_gen_placement(tpw_gen *gen, int *cpus, size_t length) {
+    size_t count = 0;
+    for (size_t i = 0; i < gen->maxthreads; i++) {
+        if (atomic_load_explicit(&gen->slots[i].occupied, memory_order_acquire)) {
+            if (count < length) {
+                cpus[count] = gen->slots[i].cpu;
+            }
+            count++;
+        }
+    }
+    return count;
+}
+
+tpw_node * tpw_gen_node(tpw_gen *gen, size_t id) {
+    for (size_t i = 0; i < gen->num_nodes; i++) {
+        if (gen->nodes[i].id == id) {
+            return &gen->nodes[i];
+        }
+    }
+    return NULL;
+}
+
+tpw_node * tpw_gen_local(tpw_gen *gen) {
+    if (!gen->num_nodes) {
+        return NULL;
+    }
+    if (tpw_self && tpw_self->gen == gen) {
+        return &gen->nodes[tpw_self->slot->node];
+    }
+    int cpu = sched_getcpu();
+    return &gen->nodes[cpu >= 0 && (size_t) cpu < gen->num_cpunode ? gen->cpunode[cpu] : 0];
+}
+
+bool tpw_node_offer(tpw_node *node, tpi_task task) {
+    return tpq_ring_push(&node->ring, task);
+}
+
+tpi_error tpw_worker_push(tpw_worker *worker, tpi_task task) {
+    return tpd_push(&worker->slot->deque, task);
+}
+
 void tpw_gen_destory(tpw_gen *gen) {
+    while (atomic_load_explicit(&gen->live, memory_order_acquire)) {
+        sched_yield();
+    }
     pthread_attr_destroy(&gen->attr);
+    for (size_t i = 0; i < gen->maxthreads; i++) {
+        if (gen->slots[i].joinable) {
+            pthread_join(gen->slots[i].thread, NULL);
+        }
+        if (gen->stealing) {
+            tpi_task task;
+            while (tpd_pop(&gen->slots[i].deque, &task)) {
+                tpw_discard(gen->slab, NULL, task);
+            }
+            tpd_destroy(&gen->slots[i].deque);
+        }
+        tps_clear(&gen->slots[i].cache);
+    }
+    for (size_t i = 0; i < gen->num_nodes; i++) {
+        tpi_task task;
+        while (tpq_ring_pop(&gen->nodes[i].ring, &task)) {
+            tpw_discard(gen->slab, NULL, task);
+        }
+    }
+    tpw_gen_unnuma(gen);
+    tpw_gen_unarena(gen);
+    free(gen->slots);
+    free(gen->cpus);
     bzero(gen, sizeof(tpw_gen));
-}
\ No newline at end of file
+}
@@ -1,38 +1,109 @@
 #ifndef worker_h
 #define worker_h
 
+typedef struct {
+    tpq_ring ring;
+    size_t id;
+    size_t *cpus;
+    size_t num_cpus;
+    size_t length;
+} tpw_node;
+
+typedef struct {
+    atomic_bool occupied;
+    int cpu;
+    size_t node;
+    pthread_t thread;
+    bool joinable;
+    tpd_deque deque;
+    tps_cache cache;
+} tpw_slot;
+
 typedef struct {
     size_t stacksize;
     size_t guardsize;
+    bool arena;
+    bool prefault;
     tpi_schedule schedule;
     tpi_contentionscope scope;
+    tpi_affinity affinity;
+    const size_t *cpus;
+    size_t num_cpus;
+    bool numa;
+    size_t nodesize;
     tpq_queue *queue;
+    tps_slab *slab;
     size_t minthreads;
+    size_t maxthreads;
+    size_t spins;
+    size_t yields;
+    size_t keepalive;
+    bool stealing;
+    bool timed;
     void (* ontaskfailed)(int, void *, void *);
     void *g_data;
     void *userdata;
 } tpw_gen_config;
 
+typedef struct tpw_worker tpw_worker;
+
 typedef struct {
     pthread_attr_t attr;
+    unsigned char *arena;
+    size_t arenasize;
+    size_t stride;
+    size_t guard;
+    bool prefault;
+    tpw_worker *workers;
+    tpi_affinity affinity;
+    size_t *cpus;
+    size_t num_cpus;
+    tpw_node *nodes;
+    size_t num_nodes;
+    size_t *cpunode;
+    size_t num_cpunode;
     tpq_queue *queue;
+    tps_slab *slab;
+    tpw_slot *slots;
+    atomic_size_t live;
     size_t minthreads;
+    atomic_size_t floor;
+    size_t maxthreads;
+    size_t spins;
+    size_t yields;
+    size_t keepalive;
+    bool stealing;
+    bool timed;
     void (* ontaskfailed)(int, void *, void *);
     void *g_data;
     void *userdata;
 } tpw_gen;
 
-typedef struct {
+struct tpw_worker {
     pthread_t thread;
+    tpw_gen *gen;
+    tpw_slot *slot;
+    tpc_shard *shard;
     tpq_queue *queue;
-    size_t minthreads;
+    size_t seed;
+    bool timed;
     void (* ontaskfailed)(int, void *, void *);
     void *g_data;
     void *userdata;
-} tpw_worker;
+};
 
 tpi_error tpw_gen_init(tpw_gen *gen, tpw_gen_config config);
 tpi_error tpw_gen_generate(tpw_gen *gen);
+tpw_worker * tpw_gen_current(tpw_gen *gen);
+tps_cache * tpw_gen_cache(tpw_gen *gen);
+bool tpw_gen_ismember(tpw_gen *gen);
+size_t tpw_gen_setfloor(tpw_gen *gen, size_t floor);
+size_t tpw_gen_placement(tpw_gen *gen, int *cpus, size_t length);
+tpw_node * tpw_gen_node(tpw_gen *gen, size_t id);
+tpw_node * tpw_gen_local(tpw_gen *gen);
+bool tpw_node_offer(tpw_node *node, tpi_task task);
+tpi_error tpw_worker_push(tpw_worker *worker, tpi_task task);
+void tpw_discard(tps_slab *slab, tps_cache *cache, tpi_task task);
 void tpw_gen_destory(tpw_gen *gen);
 
 #endif